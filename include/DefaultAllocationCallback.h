@@ -18,6 +18,8 @@ namespace ux3d
 		private:
 			static void* allocate(void* _pUserData, size_t _size);
 			static void deallocate(void* _pUserData, void* _pData);
+			static void* allocateAligned(void* _pUserData, size_t _size, size_t _alignment);
+			static void deallocateAligned(void* _pUserData, void* _pData);
 		};
 	} // !slimktx2
 } // !ux3d
\ No newline at end of file
@@ -0,0 +1,82 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#pragma once
+
+#include "callbacks.h"
+
+namespace ux3d
+{
+	namespace slimktx2
+	{
+		// bump allocator for the many small metadata allocations of parsing (level index, dfd blocks and samples, kvd entries, sgd buffers).
+		// allocations up to _maxArenaAllocation bytes are served from blocks of _blockSize bytes, larger ones (level data) are passed through to
+		// the allocate / deallocate callbacks of _callbacks. arena memory is released in stack order: deallocating the most recent allocation of the
+		// current block (e.g. the temporaries of loadLevels or transcodeRegion) pops it together with the already deallocated allocations below it,
+		// other deallocations only mark the memory. once all arena allocations are deallocated (e.g. after SlimKTX2::clear) the arena rewinds to its
+		// first block in O(1) and the blocks are reused for the next file.
+		// limits: memory below a live allocation (e.g. a level index allocated after a temporary) and blocks before the current one are only reused
+		// after the rewind, which a long lived allocation (a TranscoderContext, a second SlimKTX2 on the same arena) prevents. use separate arenas
+		// for objects with different lifetimes.
+		// not thread safe, use one arena per thread. the arena uses userData, the parallelFor callback of _callbacks is forwarded with its userData
+		class DefaultArenaAllocationCallback
+		{
+		public:
+			DefaultArenaAllocationCallback(const Callbacks& _callbacks, size_t _blockSize = 64u * 1024u, size_t _maxArenaAllocation = 16u * 1024u);
+			~DefaultArenaAllocationCallback();
+
+			DefaultArenaAllocationCallback(const DefaultArenaAllocationCallback&) = delete;
+			DefaultArenaAllocationCallback& operator=(const DefaultArenaAllocationCallback&) = delete;
+
+			Callbacks getCallback() const;
+
+			operator Callbacks() const;
+
+			// rewinds the arena and frees all blocks but the first one. arena memory that was not deallocated must no longer be used
+			void reset();
+
+			uint32_t getBlockCount() const;
+
+			// bytes of the arena blocks in use, including headers and alignment
+			size_t getUsedSize() const;
+
+		private:
+			static constexpr uint32_t NoOffset = 0xffffffffu;
+
+			struct Block
+			{
+				Block* pNext = nullptr;
+				size_t size = 0u; // usable bytes after the block header
+				size_t offset = 0u;
+				uint32_t lastOffset = NoOffset; // most recent allocation, popped when deallocated
+			};
+
+			static void* allocate(void* _pUserData, size_t _size);
+			static void deallocate(void* _pUserData, void* _pData);
+			static void parallelFor(void* _pUserData, uint32_t _count, TaskFunc _task, void* _pTaskData);
+
+			void* allocateFromArena(size_t _size);
+
+			// releases the deallocated allocations at the top of the current block
+			void popDeallocated();
+
+			// makes the block after m_pCurrent current, allocates it if there is none
+			bool nextBlock();
+
+			// all blocks are empty again
+			void rewind();
+
+		private:
+			Callbacks m_callbacks{};
+
+			size_t m_blockSize = 0u;
+			size_t m_maxArenaAllocation = 0u;
+
+			Block* m_pBlocks = nullptr; // linked list in allocation order
+			Block* m_pCurrent = nullptr;
+			uint32_t m_blockCount = 0u;
+
+			// arena allocations that were not deallocated yet
+			size_t m_liveCount = 0u;
+		};
+	} // !slimktx2
+} // !ux3d
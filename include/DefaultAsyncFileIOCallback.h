@@ -0,0 +1,32 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#pragma once
+
+#include "callbacks.h"
+
+namespace ux3d
+{
+	namespace slimktx2
+	{
+		// IOHandle assumed to be C FILE handle, same as DefaultFileIOCallback with an additional readBatch callback
+		// that keeps up to QueueDepth level reads in flight using io_uring (Linux, SLIMKTX2_USE_IO_URING).
+		// without io_uring support readBatch is not set and levels are read with concurrent pread (readAt + parallelFor)
+		class DefaultAsyncFileIOCallback
+		{
+		public:
+			static constexpr uint32_t QueueDepth = 64u;
+
+			Callbacks getCallback() const;
+
+			operator Callbacks() const;
+
+			// true if readBatch is available on this platform / build
+			static bool isSupported();
+
+		private:
+			// one ring per calling thread, created on first use.
+			// returns false if the ring can not be created, unfinished requests are completed by the caller
+			static bool readBatch(void* _pUserData, IOHandle _file, ReadRequest* _pRequests, uint32_t _count);
+		};
+	} // !slimktx2
+} // !ux3d
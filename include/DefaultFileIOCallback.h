@@ -21,6 +21,10 @@ namespace ux3d
 			static void write(void* _pUserData, IOHandle _file, const void* _pData, size_t _size);
 			static size_t tell(void* _pUserData, IOHandle _file);
 			static bool seek(void* _pUserData, IOHandle _file, size_t _offset);
+
+			// pread on the underlying file descriptor (ReadFile with an offset on the CRT handle on Windows), bypasses the stdio buffer.
+			// concurrent calls on the same file are safe. on Windows the stream position is undefined afterwards, fseek before reading sequentially again
+			static size_t readAt(void* _pUserData, IOHandle _file, size_t _offset, void* _pData, size_t _size);
 		};
 
 	} // !slimktx2
@@ -15,25 +15,48 @@ namespace ux3d
 		public:
 			// read constructor
 			DefaultMemoryStream(const uint8_t* _pData, const size_t _size) :
-				m_pDataConst(_pData), m_size(_size) {}
+				m_pDataConst(_pData), m_size(_size), m_capacity(_size) {}
 
-			// read write
+			// read write, writes are truncated at _size
 			DefaultMemoryStream(uint8_t* _pData, const size_t _size) :
-				m_pDataConst(_pData), m_pData(_pData), m_size(_size) {}
+				m_pDataConst(_pData), m_pData(_pData), m_size(_size), m_capacity(_size) {}
+
+			// growable write stream, memory is allocated with the allocate / deallocate callbacks of _allocationCallbacks.
+			// getSize() returns the number of bytes written
+			DefaultMemoryStream(const Callbacks& _allocationCallbacks, const size_t _initialCapacity = 0u);
+
+			~DefaultMemoryStream();
+
+			DefaultMemoryStream(const DefaultMemoryStream&) = delete;
+			DefaultMemoryStream& operator=(const DefaultMemoryStream&) = delete;
 
 			const uint8_t* getDataConst() const { return m_pDataConst; };
 			uint8_t* getData() const { return m_pData; };
 
 			size_t getSize() const { return m_size; };
+			size_t getCapacity() const { return m_capacity; };
 
 			size_t getOffset() const { return m_offset; };
 			void setOffset(size_t _offset) { m_offset = _offset; };
 
+			bool isGrowable() const { return m_allocationCallbacks.allocate != nullptr; };
+
+			// makes sure _capacity bytes can be written without reallocation, returns false for fixed size streams that are too small
+			bool reserve(size_t _capacity);
+
+			// writes _size bytes at the current offset and advances it, grows the stream if required.
+			// returns the number of bytes written (less than _size if a fixed size stream is full)
+			size_t write(const void* _pData, size_t _size);
+
 		private:
 			const uint8_t* m_pDataConst = nullptr;
 			uint8_t* m_pData = nullptr;
-			const size_t m_size = 0u;
+			size_t m_size = 0u;
+			size_t m_capacity = 0u;
 			size_t m_offset = 0u;
+
+			// only set for growable streams
+			Callbacks m_allocationCallbacks{};
 		};
 
 		// assumes IOHandle is of type DefaultMemoryStream
@@ -49,6 +72,8 @@ namespace ux3d
 			static void write(void* _pUserData, IOHandle _iohandle, const void* _pData, size_t _size);
 			static size_t tell(void* _pUserData, IOHandle _iohandle);
 			static bool seek(void* _pUserData, IOHandle _iohandle, size_t _offset);
+			static size_t readAt(void* _pUserData, IOHandle _iohandle, size_t _offset, void* _pData, size_t _size);
+			static bool reserve(void* _pUserData, IOHandle _iohandle, size_t _size);
 		};
 	} // !slimktx2
 } // !ux3d
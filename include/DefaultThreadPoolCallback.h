@@ -0,0 +1,71 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#pragma once
+
+#include "callbacks.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ux3d
+{
+	namespace slimktx2
+	{
+		// persistent worker threads, the thread calling parallelFor participates in executing its tasks.
+		// parallelFor may be called concurrently and from within tasks.
+		class DefaultThreadPoolCallback
+		{
+		public:
+			// _workerCount = 0 uses one worker less than the hardware concurrency
+			DefaultThreadPoolCallback(uint32_t _workerCount = 0u);
+			~DefaultThreadPoolCallback();
+
+			DefaultThreadPoolCallback(const DefaultThreadPoolCallback&) = delete;
+			DefaultThreadPoolCallback& operator=(const DefaultThreadPoolCallback&) = delete;
+
+			Callbacks getCallback() const;
+
+			operator Callbacks() const;
+
+			uint32_t getWorkerCount() const;
+
+		private:
+			struct Job
+			{
+				TaskFunc task = nullptr;
+				void* pTaskData = nullptr;
+				uint32_t count = 0u;
+
+				std::atomic<uint32_t> next{ 0u };
+
+				// number of workers currently executing tasks of this job, guarded by m_mutex
+				uint32_t users = 0u;
+
+				Job* pNext = nullptr;
+			};
+
+			static void parallelFor(void* _pUserData, uint32_t _count, TaskFunc _task, void* _pTaskData);
+
+			// executes unclaimed tasks of _job until all are claimed
+			static void execute(Job& _job);
+
+			void workerLoop();
+
+			// first job with unclaimed tasks, requires m_mutex to be locked
+			Job* findJob() const;
+
+		private:
+			std::thread* m_pWorkers = nullptr;
+			uint32_t m_workerCount = 0u;
+
+			std::mutex m_mutex;
+			std::condition_variable m_wakeWorkers;
+			std::condition_variable m_jobFinished;
+
+			Job* m_pJobs = nullptr; // linked list
+			bool m_shutdown = false;
+		};
+	} // !slimktx2
+} // !ux3d
@@ -4,6 +4,7 @@
 
 #include <cstdarg>
 #include <cstddef>
+#include <cstdint>
 
 namespace ux3d
 {
@@ -12,6 +13,10 @@ namespace ux3d
 		using AllocationFunc = void* (*)(void* _pUserData, size_t _size);
 		using DeallocationFunc = void(*)(void* _pUserData, void* _pData);
 
+		// _alignment is a power of two, memory of AlignedAllocationFunc is freed with AlignedDeallocationFunc
+		using AlignedAllocationFunc = void* (*)(void* _pUserData, size_t _size, size_t _alignment);
+		using AlignedDeallocationFunc = void(*)(void* _pUserData, void* _pData);
+
 		// IO - stream or file
 		using IOHandle = void*;
 
@@ -19,9 +24,30 @@ namespace ux3d
 		using WriteFunc = void(*)(void* _pUserData, IOHandle _file, const void* _pData, size_t _size);
 		using TellFunc = size_t(*)(void* _pUserData, const IOHandle _file);
 		using SeekFunc = bool(*)(void* _pUserData, IOHandle _file, size_t _offset);
+		using ReserveFunc = bool(*)(void* _pUserData, IOHandle _file, size_t _size);
+
+		// positional read like pread(), must not depend on or change the stream position and must be safe to call concurrently
+		using ReadAtFunc = size_t(*)(void* _pUserData, IOHandle _file, size_t _offset, void* _pData, size_t _size);
+
+		// positional read of a batch, see ReadBatchFunc
+		struct ReadRequest
+		{
+			size_t offset = 0u;
+			void* pData = nullptr;
+			size_t size = 0u;
+			size_t bytesRead = 0u; // written by the callback
+		};
+
+		// issues all requests (several may be in flight at once) and returns once all are finished.
+		// returns false if any request is incomplete, the remaining bytes are then read with readAt / seek + read
+		using ReadBatchFunc = bool(*)(void* _pUserData, IOHandle _file, ReadRequest* _pRequests, uint32_t _count);
 
 		using LogFunc = void(*)(void* _pUserData, const char* _pFormat, va_list args);
 
+		// parallel execution - calls _task(_pTaskData, i) for all i in [0, _count) and returns once all tasks are finished
+		using TaskFunc = void(*)(void* _pTaskData, uint32_t _index);
+		using ParallelForFunc = void(*)(void* _pUserData, uint32_t _count, TaskFunc _task, void* _pTaskData);
+
 		struct Callbacks
 		{
 			void* userData = nullptr; // holds allocator, user implementations
@@ -29,14 +55,30 @@ namespace ux3d
 			AllocationFunc allocate = nullptr;
 			DeallocationFunc deallocate = nullptr;
 
+			// optional, used for level storage. if not set aligned level storage is carved out of a larger allocate() block
+			AlignedAllocationFunc allocateAligned = nullptr;
+			AlignedDeallocationFunc deallocateAligned = nullptr;
+
 			ReadFunc read = nullptr;
 			WriteFunc write = nullptr;
 
 			TellFunc tell = nullptr;
 			SeekFunc seek = nullptr;
 
+			// optional, replaces seek + read when parsing
+			ReadAtFunc readAt = nullptr;
+
+			// optional, reads all levels of a parse / loadLevels call at once
+			ReadBatchFunc readBatch = nullptr;
+
+			// optional, called by serialize with the final stream size (stream position + file size) before writing
+			ReserveFunc reserve = nullptr;
+
 			// optional
 			LogFunc log = nullptr;
+
+			// optional, tasks are executed sequentially on the calling thread if not set
+			ParallelForFunc parallelFor = nullptr;
 		};
 
 		inline Callbacks operator|(const Callbacks& _lhs, const Callbacks& _rhs)
@@ -46,11 +88,17 @@ namespace ux3d
 			if (callback.userData == nullptr) { callback.userData = _rhs.userData; }
 			if (callback.allocate == nullptr) { callback.allocate = _rhs.allocate; }
 			if (callback.deallocate == nullptr) { callback.deallocate = _rhs.deallocate; }
+			if (callback.allocateAligned == nullptr) { callback.allocateAligned = _rhs.allocateAligned; }
+			if (callback.deallocateAligned == nullptr) { callback.deallocateAligned = _rhs.deallocateAligned; }
 			if (callback.read == nullptr) { callback.read = _rhs.read; }
 			if (callback.write == nullptr) { callback.write = _rhs.write; }
 			if (callback.tell == nullptr) { callback.tell = _rhs.tell; }
 			if (callback.seek == nullptr) { callback.seek = _rhs.seek; }
+			if (callback.readAt == nullptr) { callback.readAt = _rhs.readAt; }
+			if (callback.readBatch == nullptr) { callback.readBatch = _rhs.readBatch; }
+			if (callback.reserve == nullptr) { callback.reserve = _rhs.reserve; }
 			if (callback.log == nullptr) { callback.log = _rhs.log; }
+			if (callback.parallelFor == nullptr) { callback.parallelFor = _rhs.parallelFor; }
 			
 			return callback;
 		}
@@ -344,7 +344,7 @@ namespace ux3d
 
 		struct DataFormatDesc
 		{
-			uint32_t totalSize{};
+			uint32_t totalSize{}; // byte size of pData, 0 without blocks
 
 			//https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html#DescriptorPrefix
 			struct BlockHeader
@@ -399,24 +399,32 @@ namespace ux3d
 			static constexpr uint32_t blockHeaderSize = sizeof(BlockHeader); // 24u
 			static constexpr uint32_t sampleSize = sizeof(Sample); // 16u
 
+			// view of a block in DataFormatDesc::pData
 			struct Block
 			{
 				uint32_t getSampleCount() const { return (header.blockSize - blockHeaderSize) / sampleSize; }
-				void setSampleCount(uint32_t _sampleCount) { header.blockSize = blockHeaderSize + _sampleCount * sampleSize; }
 
 				BlockHeader header{};
 				// ...
 				// Sample information for the first sample
 				// Sample information for the second sample (optional), etc.
-				Sample* pSamples = nullptr; // uint32_t[sampleCount]
-				Block* pNext = nullptr;
+				const Sample* pSamples = nullptr; // Sample[sampleCount], nullptr without samples
+				uint32_t byteOffset = 0u; // of the block header in pData
 			};
 
-			Block* pBlocks = nullptr; // Linked list
+			// the whole descriptor in file layout: totalSize followed by the blocks and their samples
+			uint8_t* pData = nullptr;
+			uint32_t blockCount = 0u;
 
 			uint32_t computeSize() const;
 
-            Block* getLastBlock() const;
+			// returns false if there is no block
+			bool getFirstBlock(Block& _block) const;
+			// advances _block to the block after it, returns false if _block was the last one
+			bool getNextBlock(Block& _block) const;
+
+			// reads totalSize from pData (_byteSize bytes), checks that it fits and is covered by the blocks and counts them
+			bool validate(uint32_t _byteSize);
 		};
 	} // !slimktx2
 } // !ux3d
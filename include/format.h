@@ -229,8 +229,8 @@ namespace ux3d
 			RGB565 = 14,
 			BGR565 = 15,
 			RGBA4444 = 16,
-			//ETC = 22, // Automatically selects @c ETC1_RGB or @c ETC2_RGBA according to presence of alpha. 
-			//BC1_OR_3 = 23, //Automatically selects @c BC1_RGB or @c BC3_RGBA according to presence of alpha.
+			ETC = 22, // Automatically selects @c ETC1_RGB or @c ETC2_RGBA according to presence of alpha.
+			BC1_OR_3 = 23, //Automatically selects @c BC1_RGB or @c BC3_RGBA according to presence of alpha.
 
 			UNDEFINED = ~0u
 		};
@@ -264,6 +264,13 @@ namespace ux3d
 
 		uint64_t getFaceSize(Format _vkFormat, uint32_t _level, uint32_t _width, uint32_t _height, uint32_t _depth = 0u);
 
+		// bytes of one row of blocks (texels for formats that are not BLOCK) of an image _width pixels wide
+		uint64_t getRowPitch(Format _vkFormat, uint32_t _width);
+
+		// copies the _width x _height pixel rectangle at _x, _y of a 2D image _srcWidth pixels wide to _pDst, rows are _dstRowPitch bytes apart.
+		// _x and _y have to be multiples of the block size of _vkFormat
+		void copyRegion(Format _vkFormat, const uint8_t* _pSrc, uint32_t _srcWidth, uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height, uint8_t* _pDst, uint64_t _dstRowPitch);
+
 		// computes the pixel count (resolution) of an image of the given level
 		uint32_t getPixelCount(uint32_t _level, uint32_t _width, uint32_t _height, uint32_t _depth);
 
@@ -276,5 +283,8 @@ namespace ux3d
 		uint32_t getMipPadding(uint64_t _value, Format _vkFormat, bool _superCompression);
 
 		Format transcodeToVkFormat(TranscodeFormat _format, bool _sRGB);
+
+		// resolves the automatic formats ETC and BC1_OR_3 to the opaque or alpha variant, other formats are returned as is
+		TranscodeFormat resolveTranscodeFormat(TranscodeFormat _format, bool _hasAlpha);
 	}// !slimktx2
 } // ux3d
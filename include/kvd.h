@@ -16,6 +16,9 @@ namespace ux3d
 			static constexpr auto KTXwriterValue = "UX3D SlimKTX2 v1.0";
 			static constexpr auto KTXwriterValueLength = sizeof("UX3D SlimKTX2 v1.0");
 
+			// power of two, entries of a bucket are chained through Entry::pNextInBucket
+			static constexpr uint32_t BucketCount = 32u;
+
 			struct Entry
 			{
 				uint32_t keyAndValueByteLength = 0u;
@@ -25,12 +28,41 @@ namespace ux3d
 				uint32_t getKeyLength() const;
 				uint32_t getValueLength() const;	
 
+				// value after the key and its null terminator, nullptr if there is none
+				const uint8_t* getValue() const;
+
 				Entry* pNext = nullptr;
+
+				// cached by addToIndex, the accessors above scan pKeyValue for entries that were not indexed
+				uint32_t keyLength = 0u; // without null terminator
+				uint32_t keyHash = 0u;
+				Entry* pNextInBucket = nullptr;
 			};
 
 			Entry* pKeyValues = nullptr; // linked list
+			Entry* pLastEntry = nullptr;
+			Entry* pBuckets[BucketCount] = {};
+
 			uint32_t computeSize() const; // includes per-entry padding
 			Entry* getLastEntry() const;
+
+			// links _pEntry after the last entry
+			void append(Entry* _pEntry);
+
+			// caches key length and hash of _pEntry and makes it findable, pKeyValue has to be filled
+			void addToIndex(Entry* _pEntry);
+
+			// returns nullptr if _key was not found, with duplicate keys the one added last is returned
+			const Entry* findEntry(const char* _key) const;
+
+			// returns the value of _key (without the key's null terminator) or nullptr if _key was not found
+			const uint8_t* findValue(const char* _key, uint32_t* _pValueLength = nullptr) const;
+
+			static uint32_t hashKey(const uint8_t* _pKey, uint32_t _keyLength);
+
+			// looks _key up in a raw kvd section (_byteLength bytes in file layout, e.g. read by SlimKTX2::inspect) without building the list.
+			// returns the value of _key like findValue (the last entry with duplicate keys) or nullptr if _key was not found
+			static const uint8_t* findRawValue(const uint8_t* _pData, uint32_t _byteLength, const char* _key, uint32_t* _pValueLength = nullptr);
 		};
 	} // !slimktx2
 } // ux3d
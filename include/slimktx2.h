@@ -102,9 +102,63 @@ namespace ux3d
 			KeyValueDataNotAllocated,
 			SupercompressionGlobalDataNotAllocated,
 			BasisTranscodeFailed,
-			UnknownFormat
+			UnknownFormat,
+			ZstdDecompressFailed,
+			ZstdCompressFailed,
+			InvalidRegion, // transcodeRegion rectangle is not block aligned or exceeds the level
+			StorageTooSmall, // inspect storage is smaller than InspectInfo::requiredStorageSize
+			ImageNotWritable // setImage on levels that point into the read only data passed to parseMapped
 		};
 
+		// public basisu decode flags, values match basist::basisu_decode_flags (the internal cDecodeFlagsOutputHasAlphaIndices is masked out). dont use enum class to allow combining flags
+		enum TranscodeFlag : uint32_t
+		{
+			TranscodeFlag_None = 0u,
+			TranscodeFlag_PVRTCDecodeToNextPow2 = 2u, // PVRTC1 output is padded to the next power of two
+			TranscodeFlag_AlphaToOpaqueFormats = 4u, // opaque targets (e.g. BC1, ETC1) receive the alpha channel instead of rgb
+			TranscodeFlag_BC1ForbidThreeColorBlocks = 8u,
+			TranscodeFlag_HighQuality = 32u // slower, higher quality UASTC transcoding to ETC1, ETC2, BC1 - BC5 and PVRTC
+		};
+
+		struct ParseOptions
+		{
+			// format BasisLZ images are transcoded to, ETC and BC1_OR_3 select the opaque or alpha format per file (see getHeader().vkFormat)
+			TranscodeFormat targetFormat = TranscodeFormat::RGBA32;
+
+			// levels before firstLevel are neither read, transcoded nor allocated. the header is rebased (pixelWidth, pixelHeight, pixelDepth, levelCount)
+			// so that firstLevel becomes level 0. clamped to the smallest level
+			uint32_t firstLevel = 0u;
+
+			// skips further levels until no dimension of level 0 exceeds maxResolution, 0 = no limit
+			uint32_t maxResolution = 0u;
+
+			// TranscodeFlag bits passed to basisu for BasisLZ images
+			uint32_t transcodeFlags = TranscodeFlag_None;
+		};
+
+		// filled by SlimKTX2::inspect, level index, dfd and kvd point into the storage passed to inspect
+		struct InspectInfo
+		{
+			Header header{};
+			SectionIndex sections{};
+
+			const LevelIndex* pLevels = nullptr; // getLevelCount() entries, index 0 is the largest level
+			DataFormatDesc dfd{}; // view, pData is not owned
+			const uint8_t* pKVD = nullptr; // raw kvd section of sections.kvdByteLength bytes, nullptr if empty
+
+			// bytes of storage inspect needs for level index, dfd and kvd
+			size_t requiredStorageSize = 0u;
+
+			uint32_t getLevelCount() const;
+
+			// value of _key in the raw kvd, see KeyValueData::findRawValue
+			const uint8_t* findValue(const char* _key, uint32_t* _pValueLength = nullptr) const;
+		};
+
+		// forward decl
+		class BasisTranscoder;
+		class TranscoderContext;
+
 		// Serialization API:
 
 		// SlimKTX2 ktx(callbacks);
@@ -126,12 +180,92 @@ namespace ux3d
 			SlimKTX2(const Callbacks& _callbacks);
 			~SlimKTX2();
 
+			// takes over all data, settings and callbacks of _other, which is left empty with its callbacks and settings.
+			// memory is freed with the callbacks it was allocated with
+			SlimKTX2(SlimKTX2&& _other);
+			SlimKTX2& operator=(SlimKTX2&& _other);
+
+			SlimKTX2(const SlimKTX2&) = delete;
+			SlimKTX2& operator=(const SlimKTX2&) = delete;
+
 			void setCallbacks(const Callbacks& _callbacks);
 
-			Result parse(IOHandle _file, TranscodeFormat _targetFormat = TranscodeFormat::RGBA32);
+			// shared BasisLZ transcoding state used by subsequent parse calls, caches decoded ETC1S codebooks across files.
+			// the context has to outlive this object (or the next clear()), pass nullptr to decode codebooks per file
+			void setTranscoderContext(TranscoderContext* _pContext);
 
+			// reads all levels, same as parseHeader followed by loadLevels for all levels
+			Result parse(IOHandle _file, TranscodeFormat _targetFormat = TranscodeFormat::RGBA32);
+			Result parse(IOHandle _file, const ParseOptions& _options);
+
+			// reads header, level index, dfd, kvd and sgd without loading any level, _file must stay valid until all required levels are loaded.
+			// for BasisLZ the header reports the vkFormat of _targetFormat (after resolving ETC / BC1_OR_3)
+			Result parseHeader(IOHandle _file, TranscodeFormat _targetFormat = TranscodeFormat::RGBA32);
+			Result parseHeader(IOHandle _file, const ParseOptions& _options);
+
+			// transcodes a BasisLZ file to _targetCount formats at once, _pOutImages[i] receives the result for _pTargetFormats[i] like parse() would.
+			// the file is read once and ETC1S codebooks are decoded once (shared via the transcoder context, a temporary one if none is set).
+			// outputs allocate with their own callbacks, this object keeps the metadata of the file without levels. _transcodeFlags: TranscodeFlag bits for all targets
+			Result parseMultiTarget(IOHandle _file, const TranscodeFormat* _pTargetFormats, uint32_t _targetCount, SlimKTX2* _pOutImages, uint32_t _transcodeFlags = TranscodeFlag_None);
+
+			// reads header, section index, level index, dfd and kvd of _file without allocating any memory and without changing this object,
+			// only the read callbacks (and log) are used. level index, dfd and kvd are read into _pStorage (8 byte aligned) and referenced by _info.
+			// if _storageSize is less than _info.requiredStorageSize only header and section index are filled and StorageTooSmall is returned
+			Result inspect(IOHandle _file, InspectInfo& _info, void* _pStorage, size_t _storageSize);
+
+			// parses _count files concurrently via the parallelFor callback of this object, one task per file: _pOutImages[i] receives _pFiles[i]
+			// like parse(_pFiles[i], _options) would and _pResults[i] (optional) its result. while one file waits for I/O others are transcoded.
+			// outputs allocate and read with their own callbacks, which therefore have to be usable from several threads (or differ per output).
+			// outputs without a transcoder context share the one of this object (a temporary one if none is set) for the duration of the batch.
+			// this object is not modified, returns the first failed result in file order or Success
+			Result parseBatch(const IOHandle* _pFiles, uint32_t _count, SlimKTX2* _pOutImages, Result* _pResults = nullptr, const ParseOptions& _options = ParseOptions{});
+
+			// reads (and transcodes) a level that is not yet loaded after parseHeader
+			Result loadLevel(uint32_t _level);
+
+			// loads levels _firstLevel to _lastLevel (inclusive), already loaded levels are skipped
+			Result loadLevels(uint32_t _firstLevel, uint32_t _lastLevel);
+
+			bool isLevelLoaded(uint32_t _level) const;
+
+			// writes the _width x _height pixel rectangle at _x, _y of a 2D image to _pDst in the format of the header (the transcoded format for BasisLZ and UASTC).
+			// _x and _y have to be multiples of the block size (4 for BasisLZ and UASTC), _width and _height too unless the rectangle ends at the level border.
+			// _pDst receives rows of blocks (or texels) _dstRowPitch bytes apart, 0 = tightly packed (getFaceSize(vkFormat, 0, _width, _height) bytes).
+			// loaded levels are copied, BasisLZ and uncompressed UASTC levels that are not loaded are transcoded from the file after parseHeader without loading the level:
+			// for UASTC only the blocks of the rectangle are read and transcoded, ETC1S images are transcoded to a temporary buffer.
+			// other levels that are not loaded (including zstd compressed UASTC) are loaded first
+			Result transcodeRegion(uint32_t _level, uint32_t _face, uint32_t _layer, uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height, void* _pDst, uint64_t _dstRowPitch = 0u);
+
+			// parse a KTX2 file that is fully addressable in memory (e.g. mmapped), _pData must stay valid until clear() or the next parse.
+			// for files without supercompression getImage returns pointers into _pData and no image memory is allocated,
+			// those images must not be written and setImage returns ImageNotWritable. supercompressed files are decoded from _pData to allocated storage without copying the compressed levels
+			Result parseMapped(const uint8_t* _pData, size_t _byteSize, TranscodeFormat _targetFormat = TranscodeFormat::RGBA32);
+			Result parseMapped(const uint8_t* _pData, size_t _byteSize, const ParseOptions& _options);
+
+			// Zstandard supercompressed levels are compressed in parallel if a parallelFor callback is set.
+			// BasisLZ and UASTC containers (whose levels parse has transcoded) return NotImplemented
 			Result serialize(IOHandle _file);
 
+			// computes section offsets and the level index (offsets and lengths) exactly as serialize would write them, without any I/O.
+			// Zstandard levels have to be compressed to know their size, which makes this as expensive as the compression in serialize.
+			// the compressed levels are not kept (images can be written through getImage), serialize compresses them again
+			Result computeLayout();
+
+			// total byte size serialize will write, 0 if the container is incomplete or can not be serialized. calls computeLayout, see its cost for Zstandard
+			uint64_t computeSerializedSize();
+
+			// layout computed by computeLayout / serialize / parse
+			const SectionIndex& getSectionIndex() const;
+			// levelCount entries, index 0 is the largest level
+			const LevelIndex* getLevelIndex() const;
+
+			// zstd compression level used by serialize for SupercompressionScheme::Zstandard, defaults to 3
+			void setZstdCompressionLevel(int32_t _level);
+
+			// caller owned staging buffer for serialize, small writes are combined and written in chunks of _byteSize.
+			// if not set serialize allocates a 64 KiB buffer, pass nullptr to reset
+			void setWriteBuffer(void* _pBuffer, size_t _byteSize);
+
 			uint32_t getLevelCount() const;
 			uint32_t getLayerCount() const;
 			uint32_t getFaceCount() const;
@@ -150,6 +284,21 @@ namespace ux3d
 			// allocates all image memory required for setImage
 			Result allocateMipLevelArray();
 
+			// keeps all levels in one buffer in KTX2 file order (smallest level first) with the mip padding in place, applies to the next
+			// allocateMipLevelArray / parse. levels of files without supercompression are then read and serialized with a single read / write
+			void setContiguousStorage(bool _enable);
+
+			// alignment of the level storage (every level or the contiguous storage), rounded up to a power of two, defaults to 64 bytes.
+			// applies to the next allocateMipLevelArray / parse, e.g. 4096 for page aligned upload buffers
+			void setMipAlignment(size_t _alignment);
+
+			// contiguous level storage, nullptr if levels are allocated separately (or point into a mapping, see parseMapped)
+			const uint8_t* getStorage() const;
+			// byte size of the contiguous storage including mip padding
+			uint64_t getStorageSize() const;
+			// byte offset of _level within the contiguous storage
+			uint64_t getStorageOffset(uint32_t _level) const;
+
 			// compute byte offset withing m_pContainer for the specified level, face and layer indices, requres m_pLevels to be initialized
 			uint64_t getFaceImageOffset(uint32_t _level, uint32_t _face, uint32_t _layer) const;
 
@@ -165,43 +314,137 @@ namespace ux3d
 			// free allocated memory, clear members
 			void clear();
 
+			// parse calls keep the level index, the mip level pointer array and the level buffers (or contiguous storage) of the previous file
+			// and reuse them for the next file if they are large enough, instead of freeing and allocating them again. clear() frees everything
+			void setRetainCapacity(bool _enable);
+
 		private:
 
 			void* allocate(size_t _size);
 			void free(void* _pData);
 
 			template<class T>
-			T* allocateArray(size_t _count = 1u) { return new(reinterpret_cast<T*>(allocate(sizeof(T) * _count))) T{}; }
+			T* allocateArray(size_t _count = 1u) { return new(reinterpret_cast<T*>(allocate(sizeof(T) * max<size_t>(_count, 1u)))) T{}; } // the first element is value initialized, also for _count = 0
 
 			template<class T>
 			bool read(IOHandle _file, T* _pData, size_t _count = 1u) { return _pData != nullptr && sizeof(T) * _count == m_callbacks.read(m_callbacks.userData, _file, _pData, sizeof(T) * _count); }
 
+			// uses the readAt callback if available, seek + read otherwise
 			template<class T>
-			void write(IOHandle _file, const T* _pData, size_t _count = 1u) const { m_callbacks.write(m_callbacks.userData, _file, _pData, sizeof(T)* _count); }
+			bool readAt(IOHandle _file, size_t _offset, T* _pData, size_t _count = 1u) { return _pData != nullptr && readBytesAt(_file, _offset, _pData, sizeof(T) * _count); }
 
-			void writePadding(IOHandle _file, size_t _byteSize) const;
+			bool readBytesAt(IOHandle _file, size_t _offset, void* _pData, size_t _size);
+
+			// writes are staged in the write buffer during serialize
+			template<class T>
+			void write(IOHandle _file, const T* _pData, size_t _count = 1u) { writeBytes(_file, _pData, sizeof(T) * _count); }
+
+			void writeBytes(IOHandle _file, const void* _pData, size_t _byteSize);
+			void flushWriteBuffer(IOHandle _file);
+
+			void writePadding(IOHandle _file, size_t _byteSize);
 
 			size_t tell(const IOHandle _file);
 			bool seek(IOHandle _file, size_t _offset);
 
 			void log(const char* _pFormat, ...);
 
+			// clear() for the next parse, keeps the level index, level pointers and level buffers as spares with retain capacity
+			void reset();
+
+			// takes over everything from _other and leaves it empty, requires this to be cleared
+			void moveFrom(SlimKTX2& _other);
+
+			// spare allocations kept by reset()
+			void destroySpares();
+			void retainLevelStorage(uint8_t* _pData, uint64_t _byteSize);
+			uint8_t* takeSpareLevelStorage(size_t _byteSize);
+
+			// level index with levelCount entries, reuses the spare level index
+			LevelIndex* allocateLevelIndex(uint32_t _levelCount);
+
+			// reads header, section index, level index, dfd, kvd and sgd
+			Result parseMetadata(IOHandle _file);
+
+			// drops the levels skipped by _options from the parsed metadata and rebases the header
+			void skipLevels(const ParseOptions& _options);
+
 			uint32_t getKtxLevel(uint32_t _level) const;
 
 			void destroyDFD();
 			bool readDFD(IOHandle _file);
-			void writeDFD(IOHandle _file) const;
+			void writeDFD(IOHandle _file);
 
 			void destroyKVD();
 			bool readKVD(IOHandle _file);
-			void writeKVD(IOHandle _file) const;
+			void writeKVD(IOHandle _file);
 
 			void destroySGD();
 			Result readSGD(IOHandle _file);
-			void writeSGD(IOHandle _file) const;
+			void writeSGD(IOHandle _file);
 
 			void destoryMipLevelArray();
 
+			// allocates the level pointer array with all levels unloaded, and the contiguous storage if enabled and _allowStorage is set
+			Result allocateMipLevelPointers(bool _allowStorage = true);
+			Result allocateMipLevel(uint32_t _level);
+
+			// size of all faces and layers of _level
+			uint64_t getLevelSize(uint32_t _level) const;
+
+			// UASTC files without BasisLZ supercompression (vkFormat UNDEFINED, dfd color model UASTC)
+			bool isUASTC() const;
+
+			// size of the UASTC blocks of all faces and layers of _level before transcoding
+			uint64_t getUASTCLevelSize(uint32_t _level) const;
+
+			// level memory aligned to m_mipAlignment, from the allocateAligned callback or carved out of a larger allocate() block
+			uint8_t* allocateLevelStorage(size_t _size);
+			void freeLevelStorage(uint8_t* _pData);
+
+			// uncompressed levels are read to their storage directly, supercompressed levels to a new allocation or point into m_pSourceData
+			Result allocateLevelReadBuffer(uint32_t _level, uint8_t*& _pOutReadBuffer);
+
+			// reads the levels with read buffers from m_file, as one batch if the readBatch callback is set, concurrently if the readAt callback is set
+			Result readLevels(uint8_t** _pReadLevels, uint32_t _firstLevel, uint32_t _lastLevel);
+
+			// reads the remaining bytes of all requests with readAt
+			bool readRequests(ReadRequest* _pRequests, uint32_t _count);
+
+			void destroyTranscoder();
+
+			// transcodes the BasisLZ levels flagged in _pLoadLevels reading one image at a time
+			Result streamLevels(const bool* _pLoadLevels, uint32_t _firstLevel, uint32_t _lastLevel);
+
+			// decompresses / transcodes all levels with compressed data in parallel
+			Result decompressLevels(uint8_t** _pCompressedLevels, uint32_t _firstLevel, uint32_t _lastLevel);
+
+			// transcodes BasisLZ or UASTC levels to the mip level array
+			Result transcodeLevels(uint8_t* const* _pEncodedLevels, uint32_t _firstLevel, uint32_t _lastLevel);
+
+			void unloadLevel(uint32_t _level);
+
+			// compresses all levels to a new level array _pCompressedLevels and stores the compressed sizes in the level index byteLength
+			Result compressLevels(uint8_t**& _pCompressedLevels);
+
+			// frees all levels of _pLevelData and the array itself
+			void destroyLevelData(uint8_t** _pLevelData);
+
+			// checks that everything required by serialize is specified
+			Result validateContainer();
+
+			uint64_t getSGDSize() const;
+
+			// fills the section index and level index for serialize, returns the file size
+			uint64_t layoutContainer();
+
+			// sets up the write buffer and writes the container with level data from _pLevelData
+			Result serializeContainer(IOHandle _file, uint8_t* const* _pLevelData);
+			Result writeContainer(IOHandle _file, uint8_t* const* _pLevelData);
+
+			// runs _task via the parallelFor callback or sequentially if not set
+			void parallelFor(uint32_t _count, TaskFunc _task, void* _pTaskData);
+
 		private:
 			Callbacks m_callbacks{};
 
@@ -219,6 +462,48 @@ namespace ux3d
 
 			// mipLevel array
 			uint8_t** m_pMipLevelArray = nullptr;
+
+			size_t m_mipAlignment = 64u;
+
+			// all levels in file order, m_pMipLevelArray points into it
+			bool m_contiguousStorage = false;
+			uint8_t* m_pStorage = nullptr;
+			uint64_t m_storageSize = 0u;
+
+			// caller owned file data set by parseMapped, m_pMipLevelArray points into it
+			const uint8_t* m_pMappedData = nullptr;
+
+			// file to load levels from after parseHeader
+			IOHandle m_file = nullptr;
+
+			// supercompressed file data passed to parseMapped, levels are decoded from it without reading them first
+			const uint8_t* m_pSourceData = nullptr;
+			size_t m_sourceByteSize = 0u;
+
+			// only used with basisu support
+			BasisTranscoder* m_pTranscoder = nullptr;
+			TranscoderContext* m_pTranscoderContext = nullptr;
+
+			int32_t m_zstdCompressionLevel = 3;
+
+			// spares kept by reset() with retain capacity
+			static constexpr uint32_t MaxSpareLevelStorage = 16u;
+			bool m_retainCapacity = false;
+			LevelIndex* m_pSpareLevels = nullptr;
+			uint32_t m_spareLevelCapacity = 0u;
+			uint8_t** m_pSpareMipLevelArray = nullptr;
+			uint32_t m_spareMipLevelCapacity = 0u;
+			uint8_t* m_pSpareLevelStorage[MaxSpareLevelStorage] = {};
+			uint64_t m_spareLevelStorageSize[MaxSpareLevelStorage] = {};
+			uint32_t m_spareLevelStorageCount = 0u;
+
+			// write staging
+			static constexpr size_t DefaultWriteBufferSize = 64u * 1024u;
+			uint8_t* m_pUserWriteBuffer = nullptr;
+			size_t m_userWriteBufferSize = 0u;
+			uint8_t* m_pWriteBuffer = nullptr;
+			size_t m_writeBufferSize = 0u;
+			size_t m_writeBufferOffset = 0u;
 		};
 	}// !slimktx2
 } // ux3d
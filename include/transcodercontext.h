@@ -0,0 +1,62 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#pragma once
+
+#include "callbacks.h"
+#include "basislz.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace ux3d
+{
+	namespace slimktx2
+	{
+		// long lived BasisLZ transcoding state that can be shared by many SlimKTX2 objects (see SlimKTX2::setTranscoderContext).
+		// basisu is initialized once and decoded ETC1S codebooks (endpoint / selector palettes and huffman tables) are cached
+		// by a hash of the supercompression global data, files sharing the same global codebooks only decode them once.
+		// thread safe, has to outlive all SlimKTX2 objects it is set on
+		class TranscoderContext
+		{
+		public:
+			// _callbacks: allocate / deallocate for the codebook cache, up to _maxCachedCodebooks codebooks are kept when no longer in use
+			TranscoderContext(const Callbacks& _callbacks, uint32_t _maxCachedCodebooks = 16u);
+			~TranscoderContext();
+
+			TranscoderContext(const TranscoderContext&) = delete;
+			TranscoderContext& operator=(const TranscoderContext&) = delete;
+
+			// frees all cached codebooks that are not in use
+			void trim();
+
+			// number of decoded codebooks, including those in use
+			uint32_t getCodebookCount() const;
+
+		private:
+			friend class BasisTranscoder;
+
+			// decoded basisu etc1s transcoder, defined with basisu support only
+			struct Codebook;
+
+			// returns the decoded codebook of _basisLZ, decodes it if it is not cached. nullptr if decoding failed
+			Codebook* acquire(const BasisLZ& _basisLZ);
+			void release(Codebook* _pCodebook);
+
+			// frees unused codebooks until at most _maxCount are left, requires m_mutex to be locked
+			void evict(uint32_t _maxCount);
+
+			// removes _pCodebook from the list and frees it, requires m_mutex to be locked
+			void destroy(Codebook* _pCodebook);
+
+		private:
+			Callbacks m_callbacks{};
+			uint32_t m_maxCachedCodebooks = 0u;
+
+			mutable std::mutex m_mutex;
+			std::condition_variable m_decoded; // codebooks are decoded without holding m_mutex
+
+			Codebook* m_pCodebooks = nullptr; // linked list, most recently used first
+			uint32_t m_codebookCount = 0u;
+		};
+	} // !slimktx2
+} // !ux3d
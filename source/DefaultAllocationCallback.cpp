@@ -4,6 +4,10 @@
 
 #include <cstdlib>
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 using namespace ux3d::slimktx2;
 
 Callbacks DefaultAllocationCallback::getCallback() const
@@ -13,6 +17,8 @@ Callbacks DefaultAllocationCallback::getCallback() const
 	// userdata not required
 	callback.allocate = allocate;
 	callback.deallocate = deallocate;
+	callback.allocateAligned = allocateAligned;
+	callback.deallocateAligned = deallocateAligned;
 
 	return callback;
 }
@@ -31,3 +37,23 @@ void DefaultAllocationCallback::deallocate(void* _pUserData, void* _pData)
 {
 	free(_pData);
 }
+
+void* DefaultAllocationCallback::allocateAligned(void* _pUserData, size_t _size, size_t _alignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(_size, _alignment);
+#else
+	// posix_memalign requires a multiple of sizeof(void*)
+	void* pData = nullptr;
+	return posix_memalign(&pData, _alignment < sizeof(void*) ? sizeof(void*) : _alignment, _size) == 0 ? pData : nullptr;
+#endif
+}
+
+void DefaultAllocationCallback::deallocateAligned(void* _pUserData, void* _pData)
+{
+#ifdef _WIN32
+	_aligned_free(_pData);
+#else
+	free(_pData);
+#endif
+}
@@ -0,0 +1,265 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#include "DefaultArenaAllocationCallback.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+using namespace ux3d::slimktx2;
+
+namespace
+{
+	// every allocation is preceded by a header telling deallocate where it came from, it also keeps the returned memory aligned.
+	// arena headers also hold the block offset of the previous allocation in the block
+	constexpr size_t Alignment = alignof(std::max_align_t);
+	constexpr size_t HeaderSize = Alignment;
+	static_assert(HeaderSize >= 2u * sizeof(uint32_t), "arena header does not fit");
+
+	constexpr uint32_t ArenaTag = 0x414e5241u; // "ARNA"
+	constexpr uint32_t PassThroughTag = 0x53534150u; // "PASS"
+	constexpr uint32_t DeallocatedTag = 0x45455246u; // "FREE"
+
+	constexpr size_t alignUp(size_t _value)
+	{
+		return (_value + Alignment - 1u) & ~(Alignment - 1u);
+	}
+} // !namespace
+
+DefaultArenaAllocationCallback::DefaultArenaAllocationCallback(const Callbacks& _callbacks, size_t _blockSize, size_t _maxArenaAllocation) :
+	m_blockSize(alignUp(_blockSize < NoOffset - Alignment ? _blockSize : NoOffset - Alignment)), // offsets in the headers are 32 bit
+	m_maxArenaAllocation(_maxArenaAllocation)
+{
+	m_callbacks.userData = _callbacks.userData;
+	m_callbacks.allocate = _callbacks.allocate;
+	m_callbacks.deallocate = _callbacks.deallocate;
+	m_callbacks.parallelFor = _callbacks.parallelFor;
+}
+
+DefaultArenaAllocationCallback::~DefaultArenaAllocationCallback()
+{
+	while (m_pBlocks != nullptr)
+	{
+		Block* pNext = m_pBlocks->pNext;
+		m_callbacks.deallocate(m_callbacks.userData, m_pBlocks);
+		m_pBlocks = pNext;
+	}
+}
+
+Callbacks DefaultArenaAllocationCallback::getCallback() const
+{
+	Callbacks callback{};
+
+	callback.userData = const_cast<DefaultArenaAllocationCallback*>(this);
+	callback.allocate = allocate;
+	callback.deallocate = deallocate;
+
+	if (m_callbacks.parallelFor != nullptr)
+	{
+		callback.parallelFor = parallelFor;
+	}
+
+	return callback;
+}
+
+DefaultArenaAllocationCallback::operator Callbacks() const
+{
+	return getCallback();
+}
+
+void DefaultArenaAllocationCallback::reset()
+{
+	if (m_pBlocks != nullptr)
+	{
+		Block* pBlock = m_pBlocks->pNext;
+		while (pBlock != nullptr)
+		{
+			Block* pNext = pBlock->pNext;
+			m_callbacks.deallocate(m_callbacks.userData, pBlock);
+			pBlock = pNext;
+		}
+
+		m_pBlocks->pNext = nullptr;
+		m_blockCount = 1u;
+	}
+
+	m_liveCount = 0u;
+	rewind();
+}
+
+uint32_t DefaultArenaAllocationCallback::getBlockCount() const
+{
+	return m_blockCount;
+}
+
+size_t DefaultArenaAllocationCallback::getUsedSize() const
+{
+	size_t size = 0u;
+
+	for (const Block* pBlock = m_pBlocks; pBlock != nullptr; pBlock = pBlock->pNext)
+	{
+		size += pBlock->offset;
+
+		if (pBlock == m_pCurrent)
+		{
+			break;
+		}
+	}
+
+	return size;
+}
+
+void* DefaultArenaAllocationCallback::allocate(void* _pUserData, size_t _size)
+{
+	DefaultArenaAllocationCallback& arena = *static_cast<DefaultArenaAllocationCallback*>(_pUserData);
+
+	uint8_t* pMemory = nullptr;
+	uint32_t tag = ArenaTag;
+
+	// allocations that do not fit into a block are passed through as well
+	if (_size <= arena.m_maxArenaAllocation && HeaderSize + _size <= arena.m_blockSize)
+	{
+		pMemory = static_cast<uint8_t*>(arena.allocateFromArena(HeaderSize + _size));
+	}
+	else
+	{
+		pMemory = static_cast<uint8_t*>(arena.m_callbacks.allocate(arena.m_callbacks.userData, HeaderSize + _size));
+		tag = PassThroughTag;
+	}
+
+	if (pMemory == nullptr)
+	{
+		return nullptr;
+	}
+
+	*reinterpret_cast<uint32_t*>(pMemory) = tag;
+
+	return pMemory + HeaderSize;
+}
+
+void DefaultArenaAllocationCallback::deallocate(void* _pUserData, void* _pData)
+{
+	if (_pData == nullptr)
+	{
+		return;
+	}
+
+	DefaultArenaAllocationCallback& arena = *static_cast<DefaultArenaAllocationCallback*>(_pUserData);
+	uint8_t* pMemory = static_cast<uint8_t*>(_pData) - HeaderSize;
+
+	if (*reinterpret_cast<const uint32_t*>(pMemory) == PassThroughTag)
+	{
+		arena.m_callbacks.deallocate(arena.m_callbacks.userData, pMemory);
+		return;
+	}
+
+	*reinterpret_cast<uint32_t*>(pMemory) = DeallocatedTag;
+
+	// everything is released at once when nothing is left in use, otherwise at least the top of the current block
+	if (arena.m_liveCount != 0u && --arena.m_liveCount == 0u)
+	{
+		arena.rewind();
+	}
+	else
+	{
+		arena.popDeallocated();
+	}
+}
+
+void DefaultArenaAllocationCallback::parallelFor(void* _pUserData, uint32_t _count, TaskFunc _task, void* _pTaskData)
+{
+	const DefaultArenaAllocationCallback& arena = *static_cast<DefaultArenaAllocationCallback*>(_pUserData);
+	arena.m_callbacks.parallelFor(arena.m_callbacks.userData, _count, _task, _pTaskData);
+}
+
+void* DefaultArenaAllocationCallback::allocateFromArena(size_t _size)
+{
+	const size_t size = alignUp(_size);
+
+	while (m_pCurrent == nullptr || m_pCurrent->offset + size > m_pCurrent->size)
+	{
+		if (nextBlock() == false)
+		{
+			return nullptr;
+		}
+	}
+
+	uint8_t* pData = reinterpret_cast<uint8_t*>(m_pCurrent) + alignUp(sizeof(Block)) + m_pCurrent->offset;
+
+	// link to the previous allocation for popDeallocated
+	reinterpret_cast<uint32_t*>(pData)[1] = m_pCurrent->lastOffset;
+	m_pCurrent->lastOffset = static_cast<uint32_t>(m_pCurrent->offset);
+
+	m_pCurrent->offset += size;
+	++m_liveCount;
+
+	return pData;
+}
+
+void DefaultArenaAllocationCallback::popDeallocated()
+{
+	if (m_pCurrent == nullptr)
+	{
+		return;
+	}
+
+	const uint8_t* pData = reinterpret_cast<const uint8_t*>(m_pCurrent) + alignUp(sizeof(Block));
+
+	while (m_pCurrent->lastOffset != NoOffset)
+	{
+		const uint32_t* pHeader = reinterpret_cast<const uint32_t*>(pData + m_pCurrent->lastOffset);
+		if (pHeader[0] != DeallocatedTag)
+		{
+			break;
+		}
+
+		m_pCurrent->offset = m_pCurrent->lastOffset;
+		m_pCurrent->lastOffset = pHeader[1];
+	}
+}
+
+bool DefaultArenaAllocationCallback::nextBlock()
+{
+	Block* pNext = m_pCurrent != nullptr ? m_pCurrent->pNext : m_pBlocks;
+
+	if (pNext == nullptr)
+	{
+		void* pMemory = m_callbacks.allocate(m_callbacks.userData, alignUp(sizeof(Block)) + m_blockSize);
+		if (pMemory == nullptr)
+		{
+			return false;
+		}
+
+		pNext = new(pMemory) Block();
+		pNext->size = m_blockSize;
+
+		if (m_pCurrent != nullptr)
+		{
+			m_pCurrent->pNext = pNext;
+		}
+		else
+		{
+			m_pBlocks = pNext;
+		}
+
+		++m_blockCount;
+	}
+
+	// blocks after the current one are unused since the last rewind
+	pNext->offset = 0u;
+	pNext->lastOffset = NoOffset;
+	m_pCurrent = pNext;
+
+	return true;
+}
+
+void DefaultArenaAllocationCallback::rewind()
+{
+	m_pCurrent = m_pBlocks;
+
+	if (m_pCurrent != nullptr)
+	{
+		m_pCurrent->offset = 0u;
+		m_pCurrent->lastOffset = NoOffset;
+	}
+}
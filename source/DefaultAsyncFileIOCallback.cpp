@@ -0,0 +1,197 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#include "DefaultAsyncFileIOCallback.h"
+#include "DefaultFileIOCallback.h"
+
+#ifdef SLIMKTX2_USE_IO_URING
+#include <cerrno>
+#include <cstdio>
+#include <liburing.h>
+#endif
+
+using namespace ux3d::slimktx2;
+
+#ifdef SLIMKTX2_USE_IO_URING
+namespace
+{
+	// io_uring instances must not be shared between threads without locking, every thread gets its own ring
+	struct Ring
+	{
+		io_uring ring{};
+		int state = 0; // 0 = not initialized, 1 = ready, -1 = io_uring not available
+
+		~Ring()
+		{
+			if (state == 1)
+			{
+				io_uring_queue_exit(&ring);
+			}
+		}
+
+		bool init()
+		{
+			if (state == 0)
+			{
+				state = io_uring_queue_init(DefaultAsyncFileIOCallback::QueueDepth, &ring, 0u) == 0 ? 1 : -1;
+			}
+
+			return state == 1;
+		}
+	};
+
+	thread_local Ring t_ring;
+
+	// single reads are limited to 32 bit lengths
+	constexpr size_t MaxReadSize = 1u << 30u;
+} // !namespace
+#endif
+
+Callbacks DefaultAsyncFileIOCallback::getCallback() const
+{
+	Callbacks callback = DefaultFileIOCallback().getCallback();
+
+	// userdata not required
+#ifdef SLIMKTX2_USE_IO_URING
+	callback.readBatch = readBatch;
+#endif
+
+	return callback;
+}
+
+DefaultAsyncFileIOCallback::operator Callbacks() const
+{
+	return getCallback();
+}
+
+bool DefaultAsyncFileIOCallback::isSupported()
+{
+#ifdef SLIMKTX2_USE_IO_URING
+	return t_ring.init();
+#else
+	return false;
+#endif
+}
+
+bool DefaultAsyncFileIOCallback::readBatch(void* _pUserData, IOHandle _file, ReadRequest* _pRequests, uint32_t _count)
+{
+#ifdef SLIMKTX2_USE_IO_URING
+	if (t_ring.init() == false)
+	{
+		return false;
+	}
+
+	io_uring* pRing = &t_ring.ring;
+	const int fd = fileno(static_cast<FILE*>(_file));
+
+	// queues the remaining bytes of _request
+	auto submit = [&](ReadRequest& _request) -> bool
+	{
+		io_uring_sqe* pSqe = io_uring_get_sqe(pRing);
+		if (pSqe == nullptr)
+		{
+			return false;
+		}
+
+		const size_t remaining = _request.size - _request.bytesRead;
+		const unsigned int size = static_cast<unsigned int>(remaining > MaxReadSize ? MaxReadSize : remaining);
+
+		io_uring_prep_read(pSqe, fd, static_cast<uint8_t*>(_request.pData) + _request.bytesRead, size, _request.offset + _request.bytesRead);
+		io_uring_sqe_set_data(pSqe, &_request);
+
+		return true;
+	};
+
+	uint32_t next = 0u;
+	uint32_t inFlight = 0u;
+	bool failed = false;
+
+	while (inFlight > 0u || (next < _count && failed == false))
+	{
+		// fill the submission queue
+		while (next < _count && inFlight < QueueDepth && failed == false)
+		{
+			ReadRequest& request = _pRequests[next];
+			if (request.bytesRead >= request.size)
+			{
+				++next;
+				continue;
+			}
+
+			if (submit(request) == false)
+			{
+				// a full queue drains below, without reads in flight nothing frees a slot
+				failed = inFlight == 0u;
+				break;
+			}
+
+			++next;
+			++inFlight;
+		}
+
+		if (inFlight == 0u)
+		{
+			break;
+		}
+
+		const int submitted = io_uring_submit_and_wait(pRing, 1u);
+		if (submitted < 0 && submitted != -EINTR)
+		{
+			// the ring is in an unknown state, stop using it on this thread and let the caller read the rest
+			io_uring_queue_exit(pRing);
+			t_ring.state = -1;
+			return false;
+		}
+
+		io_uring_cqe* pCqe = nullptr;
+		while (io_uring_peek_cqe(pRing, &pCqe) == 0 && pCqe != nullptr)
+		{
+			ReadRequest& request = *static_cast<ReadRequest*>(io_uring_cqe_get_data(pCqe));
+			const int res = pCqe->res;
+			io_uring_cqe_seen(pRing, pCqe);
+			--inFlight;
+
+			if (res > 0)
+			{
+				request.bytesRead += static_cast<size_t>(res);
+			}
+			else if (res != -EINTR && res != -EAGAIN)
+			{
+				// error or unexpected end of file
+				failed = true;
+				continue;
+			}
+
+			// short read, queue the rest
+			if (request.bytesRead < request.size && failed == false)
+			{
+				if (submit(request))
+				{
+					++inFlight;
+				}
+				else
+				{
+					failed = true;
+				}
+			}
+		}
+	}
+
+	if (failed)
+	{
+		return false;
+	}
+
+	// true promises that every request is complete
+	for (uint32_t i = 0u; i < _count; ++i)
+	{
+		if (_pRequests[i].bytesRead < _pRequests[i].size)
+		{
+			return false;
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
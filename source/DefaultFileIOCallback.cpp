@@ -3,6 +3,15 @@
 #include "DefaultFileIOCallback.h"
 
 #include <cstdio>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
 
 using namespace ux3d::slimktx2;
 
@@ -15,6 +24,7 @@ Callbacks DefaultFileIOCallback::getCallback() const
 	callback.write = write;
 	callback.seek = seek;
 	callback.tell = tell;
+	callback.readAt = readAt;
 
 	return callback;
 }
@@ -47,3 +57,61 @@ bool DefaultFileIOCallback::seek(void* _pUserData, IOHandle _file, size_t _offse
 	FILE* pFile = static_cast<FILE*>(_file);
 	return fseek(pFile, _offset, SEEK_SET) == 0;
 }
+
+size_t DefaultFileIOCallback::readAt(void* _pUserData, IOHandle _file, size_t _offset, void* _pData, size_t _size)
+{
+	FILE* pFile = static_cast<FILE*>(_file);
+	uint8_t* pData = static_cast<uint8_t*>(_pData);
+	size_t total = 0u;
+
+#ifdef _WIN32
+	const HANDLE hFile = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(pFile)));
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return 0u;
+	}
+
+	// the offset is part of each request, so concurrent reads on the same handle do not interfere.
+	// ReadFile still moves the file pointer of the synchronous handle, the stream position of pFile is not preserved
+	while (total < _size)
+	{
+		const uint64_t offset = static_cast<uint64_t>(_offset) + total;
+
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32u);
+
+		const size_t remaining = _size - total;
+		const DWORD chunkSize = remaining > 0x40000000u ? 0x40000000u : static_cast<DWORD>(remaining);
+
+		DWORD bytesRead = 0u;
+		if (ReadFile(hFile, pData + total, chunkSize, &bytesRead, &overlapped) == FALSE || bytesRead == 0u)
+		{
+			break;
+		}
+
+		total += bytesRead;
+	}
+#else
+	const int fd = fileno(pFile);
+
+	while (total < _size)
+	{
+		const ssize_t bytesRead = pread(fd, pData + total, _size - total, static_cast<off_t>(_offset + total));
+
+		if (bytesRead < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (bytesRead <= 0)
+		{
+			break;
+		}
+
+		total += static_cast<size_t>(bytesRead);
+	}
+#endif
+
+	return total;
+}
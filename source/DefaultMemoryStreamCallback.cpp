@@ -6,6 +6,86 @@
 
 using namespace ux3d::slimktx2;
 
+DefaultMemoryStream::DefaultMemoryStream(const Callbacks& _allocationCallbacks, const size_t _initialCapacity)
+{
+	m_allocationCallbacks.userData = _allocationCallbacks.userData;
+	m_allocationCallbacks.allocate = _allocationCallbacks.allocate;
+	m_allocationCallbacks.deallocate = _allocationCallbacks.deallocate;
+
+	reserve(_initialCapacity);
+}
+
+DefaultMemoryStream::~DefaultMemoryStream()
+{
+	if (isGrowable() && m_pData != nullptr)
+	{
+		m_allocationCallbacks.deallocate(m_allocationCallbacks.userData, m_pData);
+	}
+}
+
+bool DefaultMemoryStream::reserve(size_t _capacity)
+{
+	if (_capacity <= m_capacity)
+	{
+		return true;
+	}
+
+	if (isGrowable() == false)
+	{
+		return false;
+	}
+
+	uint8_t* pData = static_cast<uint8_t*>(m_allocationCallbacks.allocate(m_allocationCallbacks.userData, _capacity));
+	if (pData == nullptr)
+	{
+		return false;
+	}
+
+	if (m_pData != nullptr)
+	{
+		memcpy(pData, m_pData, m_size);
+		m_allocationCallbacks.deallocate(m_allocationCallbacks.userData, m_pData);
+	}
+
+	m_pData = pData;
+	m_pDataConst = pData;
+	m_capacity = _capacity;
+
+	return true;
+}
+
+size_t DefaultMemoryStream::write(const void* _pData, size_t _size)
+{
+	if (m_offset + _size > m_capacity && isGrowable())
+	{
+		// grow geometrically to keep the number of reallocations low
+		const size_t required = m_offset + _size;
+		const size_t doubled = m_capacity * 2u;
+		reserve(required > doubled ? required : doubled);
+	}
+
+	if (m_pData == nullptr || m_offset >= m_capacity)
+	{
+		return 0u;
+	}
+
+	if (_size > m_capacity - m_offset)
+	{
+		_size = m_capacity - m_offset;
+	}
+
+	memcpy(m_pData + m_offset, _pData, _size);
+	m_offset += _size;
+
+	// fixed size streams always report their buffer size
+	if (isGrowable() && m_offset > m_size)
+	{
+		m_size = m_offset;
+	}
+
+	return _size;
+}
+
 Callbacks DefaultMemoryStreamCallback::getCallback() const
 {
 	Callbacks callback{};
@@ -14,6 +94,8 @@ Callbacks DefaultMemoryStreamCallback::getCallback() const
 	callback.write = write;
 	callback.seek = seek;
 	callback.tell = tell;
+	callback.readAt = readAt;
+	callback.reserve = reserve;
 
 	return callback;
 }
@@ -49,19 +131,7 @@ void DefaultMemoryStreamCallback::write(void* _pUserData, IOHandle _iohandle, co
 {
 	DefaultMemoryStream* stream = static_cast<DefaultMemoryStream*>(_iohandle);
 
-	const size_t size = stream->getSize();
-	size_t offset = stream->getOffset();
-
-	if (offset + _size >= size)
-	{
-		_size -= (offset + _size) - size;
-	}
-
-	if (_size != 0u)
-	{
-		uint8_t* pData = stream->getData() + offset;
-		memcpy(pData, _pData, _size);
-	}
+	stream->write(_pData, _size);
 }
 
 size_t DefaultMemoryStreamCallback::tell(void* _pUserData, IOHandle _iohandle)
@@ -74,7 +144,7 @@ bool DefaultMemoryStreamCallback::seek(void* _pUserData, IOHandle _iohandle, siz
 	DefaultMemoryStream* stream = static_cast<DefaultMemoryStream*>(_iohandle);
 
 	size_t size = stream->getSize();
-	if (_offset >= size)
+	if (_offset > size)
 	{
 		return false;
 	}
@@ -83,3 +153,28 @@ bool DefaultMemoryStreamCallback::seek(void* _pUserData, IOHandle _iohandle, siz
 
 	return true;
 }
+
+size_t DefaultMemoryStreamCallback::readAt(void* _pUserData, IOHandle _iohandle, size_t _offset, void* _pData, size_t _size)
+{
+	const DefaultMemoryStream* stream = static_cast<const DefaultMemoryStream*>(_iohandle);
+
+	const size_t size = stream->getSize();
+	if (_offset >= size)
+	{
+		return 0u;
+	}
+
+	if (_size > size - _offset)
+	{
+		_size = size - _offset;
+	}
+
+	memcpy(_pData, stream->getDataConst() + _offset, _size);
+
+	return _size;
+}
+
+bool DefaultMemoryStreamCallback::reserve(void* _pUserData, IOHandle _iohandle, size_t _size)
+{
+	return static_cast<DefaultMemoryStream*>(_iohandle)->reserve(_size);
+}
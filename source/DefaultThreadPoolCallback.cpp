@@ -0,0 +1,150 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#include "DefaultThreadPoolCallback.h"
+
+using namespace ux3d::slimktx2;
+
+DefaultThreadPoolCallback::DefaultThreadPoolCallback(uint32_t _workerCount) :
+	m_workerCount(_workerCount)
+{
+	if (m_workerCount == 0u)
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		m_workerCount = hardwareThreads > 1u ? hardwareThreads - 1u : 0u;
+	}
+
+	if (m_workerCount != 0u)
+	{
+		m_pWorkers = new std::thread[m_workerCount];
+
+		for (uint32_t i = 0u; i < m_workerCount; ++i)
+		{
+			m_pWorkers[i] = std::thread(&DefaultThreadPoolCallback::workerLoop, this);
+		}
+	}
+}
+
+DefaultThreadPoolCallback::~DefaultThreadPoolCallback()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wakeWorkers.notify_all();
+
+	for (uint32_t i = 0u; i < m_workerCount; ++i)
+	{
+		m_pWorkers[i].join();
+	}
+
+	delete[] m_pWorkers;
+}
+
+Callbacks DefaultThreadPoolCallback::getCallback() const
+{
+	Callbacks callback{};
+
+	callback.userData = const_cast<DefaultThreadPoolCallback*>(this);
+	callback.parallelFor = parallelFor;
+
+	return callback;
+}
+
+DefaultThreadPoolCallback::operator Callbacks() const
+{
+	return getCallback();
+}
+
+uint32_t DefaultThreadPoolCallback::getWorkerCount() const
+{
+	return m_workerCount;
+}
+
+void DefaultThreadPoolCallback::parallelFor(void* _pUserData, uint32_t _count, TaskFunc _task, void* _pTaskData)
+{
+	DefaultThreadPoolCallback* pPool = static_cast<DefaultThreadPoolCallback*>(_pUserData);
+
+	if (pPool == nullptr || pPool->m_workerCount == 0u || _count < 2u)
+	{
+		for (uint32_t i = 0u; i < _count; ++i)
+		{
+			_task(_pTaskData, i);
+		}
+		return;
+	}
+
+	Job job;
+	job.task = _task;
+	job.pTaskData = _pTaskData;
+	job.count = _count;
+
+	{
+		std::lock_guard<std::mutex> lock(pPool->m_mutex);
+		job.pNext = pPool->m_pJobs;
+		pPool->m_pJobs = &job;
+	}
+	pPool->m_wakeWorkers.notify_all();
+
+	execute(job);
+
+	std::unique_lock<std::mutex> lock(pPool->m_mutex);
+
+	// all tasks are claimed, no new worker may pick up the job
+	Job** ppJob = &pPool->m_pJobs;
+	while (*ppJob != &job)
+	{
+		ppJob = &(*ppJob)->pNext;
+	}
+	*ppJob = job.pNext;
+
+	// wait for workers still executing claimed tasks
+	pPool->m_jobFinished.wait(lock, [&job]() { return job.users == 0u; });
+}
+
+void DefaultThreadPoolCallback::execute(Job& _job)
+{
+	for (uint32_t i = _job.next++; i < _job.count; i = _job.next++)
+	{
+		_job.task(_job.pTaskData, i);
+	}
+}
+
+void DefaultThreadPoolCallback::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		Job* pJob = nullptr;
+		m_wakeWorkers.wait(lock, [this, &pJob]() { return m_shutdown || (pJob = findJob()) != nullptr; });
+
+		if (m_shutdown)
+		{
+			return;
+		}
+
+		++pJob->users;
+		lock.unlock();
+
+		execute(*pJob);
+
+		lock.lock();
+		if (--pJob->users == 0u)
+		{
+			m_jobFinished.notify_all();
+		}
+	}
+}
+
+DefaultThreadPoolCallback::Job* DefaultThreadPoolCallback::findJob() const
+{
+	for (Job* pJob = m_pJobs; pJob != nullptr; pJob = pJob->pNext)
+	{
+		if (pJob->next.load() < pJob->count)
+		{
+			return pJob;
+		}
+	}
+
+	return nullptr;
+}
@@ -1,187 +1,624 @@
 // Copyright (c) 2020 UX3D GmbH. All rights reserved.
 
 #include "basistranscoder.h"
-#include <transcoder/basisu_transcoder.h>
 #include "slimktx2.h"
 
-ux3d::slimktx2::BasisTranscoder::BasisTranscoder()
+#include <atomic>
+#include <cstring>
+
+#include <mutex>
+
+static_assert(ux3d::slimktx2::TranscodeFlag_PVRTCDecodeToNextPow2 == static_cast<uint32_t>(basist::cDecodeFlagsPVRTCDecodeToNextPow2), "TranscodeFlag does not match basisu");
+static_assert(ux3d::slimktx2::TranscodeFlag_AlphaToOpaqueFormats == static_cast<uint32_t>(basist::cDecodeFlagsTranscodeAlphaDataToOpaqueFormats), "TranscodeFlag does not match basisu");
+static_assert(ux3d::slimktx2::TranscodeFlag_BC1ForbidThreeColorBlocks == static_cast<uint32_t>(basist::cDecodeFlagsBC1ForbidThreeColorBlocks), "TranscodeFlag does not match basisu");
+static_assert(ux3d::slimktx2::TranscodeFlag_HighQuality == static_cast<uint32_t>(basist::cDecodeFlagsHighQuality), "TranscodeFlag does not match basisu");
+
+ux3d::slimktx2::TranscoderContext::Codebook::Codebook() :
+    etc1s(BasisTranscoder::getGlobalSelectorCodebook())
+{
+}
+
+ux3d::slimktx2::BasisTranscoder::BasisTranscoder() :
+    m_etc1s(getGlobalSelectorCodebook())
 {
-	basist::basisu_transcoder_init();
+    initBasisu();
 }
 
 ux3d::slimktx2::BasisTranscoder::~BasisTranscoder()
 {
+    if (m_pCodebook != nullptr)
+    {
+        m_pContext->release(m_pCodebook);
+    }
+}
+
+void ux3d::slimktx2::BasisTranscoder::initBasisu()
+{
+    static std::once_flag initialized;
+    std::call_once(initialized, []() { basist::basisu_transcoder_init(); });
 }
 
-bool ux3d::slimktx2::BasisTranscoder::decompress(SlimKTX2& _image, IOHandle _file, TranscodeFormat _targetFormat)
+const basist::etc1_global_selector_codebook* ux3d::slimktx2::BasisTranscoder::getGlobalSelectorCodebook()
 {
-    if (_targetFormat == TranscodeFormat::UNDEFINED)
+    static const basist::etc1_global_selector_codebook sel_codebook(basist::g_global_selector_cb_size, basist::g_global_selector_cb);
+    return &sel_codebook;
+}
+
+uint64_t ux3d::slimktx2::BasisTranscoder::hashCodebook(const BasisLZ& _basisLZ)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+
+    auto hashBytes = [&hash](const void* _pData, size_t _size)
+    {
+        const uint8_t* pData = static_cast<const uint8_t*>(_pData);
+        for (size_t i = 0u; i < _size; ++i)
+        {
+            hash = (hash ^ pData[i]) * 1099511628211ull;
+        }
+    };
+
+    const BasisLZ::Header& header = _basisLZ.header;
+    hashBytes(&header, sizeof(BasisLZ::Header));
+
+    if (_basisLZ.pEndpoints != nullptr)
+    {
+        hashBytes(_basisLZ.pEndpoints, header.endpointsByteLength);
+    }
+    if (_basisLZ.pSelectors != nullptr)
+    {
+        hashBytes(_basisLZ.pSelectors, header.selectorsByteLength);
+    }
+    if (_basisLZ.pTables != nullptr)
+    {
+        hashBytes(_basisLZ.pTables, header.tablesByteLength);
+    }
+
+    return hash;
+}
+
+bool ux3d::slimktx2::BasisTranscoder::decodeCodebook(basist::basisu_etc1s_image_transcoder& _etc1s, const BasisLZ& _basisLZ)
+{
+    const auto& header = _basisLZ.header;
+    if (_etc1s.decode_palettes(
+        header.endpointCount, _basisLZ.pEndpoints, header.endpointsByteLength,
+        header.selectorCount, _basisLZ.pSelectors, header.selectorsByteLength) == false)
     {
         return false;
     }
 
-    const auto targetFormat = static_cast<basist::transcoder_texture_format>(_targetFormat);
-    //ktx_uint32_t ktx_transcode_flags; ktx_transcode_flag_bits_e
-    const uint32_t transcodeFlags = 0u; // TODO pass flags to transcode()
+    return _etc1s.decode_tables(_basisLZ.pTables, header.tablesByteLength);
+}
+
+bool ux3d::slimktx2::BasisTranscoder::init(SlimKTX2& _image, TranscodeFormat _targetFormat, uint32_t _transcodeFlags, TranscoderContext* _pContext)
+{
+    if (_targetFormat == TranscodeFormat::UNDEFINED)
+    {
+        return false;
+    }
 
-    auto* pBlock = _image.getDFD().pBlocks;
+    DataFormatDesc::Block block;
 
-    if (pBlock == nullptr)
+    if (_image.getDFD().getFirstBlock(block) == false)
     {
         return false;
     }
 
-    const bool isETC1S = pBlock->header.colorModel == ColorModel_ETC1S;
-    const bool isUASTC = pBlock->header.colorModel == ColorModel_UASTC;
+    const bool isETC1S = block.header.colorModel == ColorModel_ETC1S;
+    const bool isUASTC = block.header.colorModel == ColorModel_UASTC;
 
     if (isETC1S == false && isUASTC == false)
     {
         return false;
     }
 
-    const bool sRGB = pBlock->header.transferFunction == TransferFunction_SRGB;
+    const bool isBasisLZ = _image.m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ);
 
-    enum alpha_content_e {
-        eNone,
-        eAlpha,
-        eGreen
-    };
+    // without image descs the depth slices of 3d textures would have to be located in the level data
+    if (isBasisLZ == false && _image.m_header.pixelDepth > 1u)
+    {
+        return false;
+    }
 
-    alpha_content_e alphaContent = eNone;
+    const bool sRGB = block.header.transferFunction == TransferFunction_SRGB;
 
-    if (isETC1S && pBlock->getSampleCount() == 2)
+    AlphaContent alphaContent = AlphaContent_None;
+
+    if (isETC1S && block.getSampleCount() == 2)
     {
-        if (pBlock->pSamples[1].channelType == ColorChannels_ETC1S_AAA)
+        if (block.pSamples[1].channelType == ColorChannels_ETC1S_AAA)
         {
-            alphaContent = eAlpha;
+            alphaContent = AlphaContent_Alpha;
         }
-        else if (pBlock->pSamples[1].channelType == ColorChannels_ETC1S_GGG)
+        else if (block.pSamples[1].channelType == ColorChannels_ETC1S_GGG)
         {
-            alphaContent = eGreen;
+            alphaContent = AlphaContent_Green;
         }
         else
         {
             return false;
         }
     }
-    else if (isUASTC && pBlock->getSampleCount() >= 1)
+    else if (isUASTC && block.getSampleCount() >= 1)
     {
-        if (pBlock->pSamples->channelType == ColorChannels_UASTC_RGBA)
+        if (block.pSamples->channelType == ColorChannels_UASTC_RGBA)
         {
-            alphaContent = eAlpha;
+            alphaContent = AlphaContent_Alpha;
         }
-        else if (pBlock->pSamples->channelType == ColorChannels_UASTC_RRRG)
+        else if (block.pSamples->channelType == ColorChannels_UASTC_RRRG)
         {
-            alphaContent = eGreen;
+            alphaContent = AlphaContent_Green;
         }
     }
 
+    // automatic targets pick the smaller opaque format unless the file has a second (alpha or green) channel
+    _targetFormat = resolveTranscodeFormat(_targetFormat, alphaContent != AlphaContent_None);
+
+    if (isETC1S && _pContext != nullptr)
+    {
+        m_pCodebook = _pContext->acquire(_image.m_basisLZ);
+        if (m_pCodebook == nullptr)
+        {
+            return false;
+        }
+
+        m_pContext = _pContext;
+        m_pETC1S = &m_pCodebook->etc1s;
+    }
+    else if (isETC1S)
+    {
+        if (decodeCodebook(m_etc1s, _image.m_basisLZ) == false)
+        {
+            return false;
+        }
+
+        m_pETC1S = &m_etc1s;
+    }
+
+    m_targetFormat = _targetFormat;
+    // basisu sets cDecodeFlagsOutputHasAlphaIndices internally, passing it in corrupts the output
+    m_transcodeFlags = _transcodeFlags & ~static_cast<uint32_t>(basist::cDecodeFlagsOutputHasAlphaIndices);
+    m_alphaContent = alphaContent;
+    m_isETC1S = isETC1S;
+    m_isBasisLZ = isBasisLZ;
+    m_isAnimation = _image.getKVD().findEntry("KTXanimData") != nullptr;
+
     // update ktx header with decoded vk format to be able to allocate the right amount of memory
     _image.m_header.vkFormat = transcodeToVkFormat(_targetFormat, sRGB);
 
-    static const basist::etc1_global_selector_codebook sel_codebook(basist::g_global_selector_cb_size, basist::g_global_selector_cb);
+    // TODO: update DFD with new color model
+
+    return true;
+}
 
-    basist::basisu_etc1s_image_transcoder bit(&sel_codebook);
-    basist::basisu_uastc_image_transcoder uit;
+bool ux3d::slimktx2::BasisTranscoder::decompressLevels(SlimKTX2& _image, uint8_t* const* _pCompressedLevels, uint32_t _firstLevel, uint32_t _lastLevel)
+{
+    const uint32_t faceCount = _image.getFaceCount();
+    const uint32_t layerCount = _image.getLayerCount();
 
-    if(isETC1S)
+    if (m_isETC1S && m_isAnimation)
     {
-        const auto& header = _image.m_basisLZ.header;
-        if (bit.decode_palettes(
-            header.endpointCount, _image.m_basisLZ.pEndpoints, header.endpointsByteLength,
-            header.selectorCount, _image.m_basisLZ.pSelectors, header.selectorsByteLength) == false)
+        // frames have to be decoded in order with the same state
+        basist::basisu_transcoder_state state;
+
+        for (uint32_t level = _firstLevel; level <= _lastLevel; ++level)
         {
-            return false;
+            if (_pCompressedLevels[level] == nullptr)
+            {
+                continue;
+            }
+
+            for (uint32_t layer = 0; layer < layerCount; ++layer)
+            {
+                for (uint32_t face = 0; face < faceCount; ++face)
+                {
+                    const uint32_t imageIndex = (level * layerCount + layer) * faceCount + face;
+                    if (transcodeImage(_image, _pCompressedLevels[level], getLevelDataSize(_image, level), getImageDesc(_image, imageIndex), level, layer, face, &state) == false)
+                    {
+                        return false;
+                    }
+                }
+            }
         }
 
-        if (bit.decode_tables(_image.m_basisLZ.pTables, header.tablesByteLength) == false)
+        return true;
+    }
+
+    struct TranscodeTask
+    {
+        BasisTranscoder* pTranscoder;
+        SlimKTX2* pImage;
+        uint8_t* const* pCompressedLevels;
+        uint32_t firstLevel;
+        uint32_t faceCount;
+        uint32_t imagesPerLevel;
+        std::atomic<bool> failed;
+    } task{ this, &_image, _pCompressedLevels, _firstLevel, faceCount, faceCount * layerCount, { false } };
+
+    _image.parallelFor((_lastLevel - _firstLevel + 1u) * task.imagesPerLevel, [](void* _pTaskData, uint32_t _index)
+    {
+        TranscodeTask& task = *static_cast<TranscodeTask*>(_pTaskData);
+
+        const uint32_t level = task.firstLevel + _index / task.imagesPerLevel;
+        const uint32_t image = _index % task.imagesPerLevel;
+
+        const uint8_t* pLevelData = task.pCompressedLevels[level];
+        if (pLevelData == nullptr)
         {
-            return false;
+            return; // was already loaded
+        }
+
+        const BasisTranscoder& transcoder = *task.pTranscoder;
+        const BasisLZ::ImageDesc desc = transcoder.getImageDesc(*task.pImage, level * task.imagesPerLevel + image);
+
+        basist::basisu_transcoder_state state;
+        if (task.pTranscoder->transcodeImage(*task.pImage, pLevelData, transcoder.getLevelDataSize(*task.pImage, level), desc, level, image / task.faceCount, image % task.faceCount, &state) == false)
+        {
+            task.failed = true;
+        }
+    }, &task);
+
+    return task.failed == false;
+}
+
+bool ux3d::slimktx2::BasisTranscoder::streamLevels(SlimKTX2& _image, const bool* _pLoadLevels, uint32_t _firstLevel, uint32_t _lastLevel)
+{
+    const uint32_t faceCount = _image.getFaceCount();
+    const uint32_t imagesPerLevel = faceCount * _image.getLayerCount();
+
+    uint32_t imageCount = 0u;
+    uint64_t maxSliceSize = 0u;
+
+    for (uint32_t level = _firstLevel; level <= _lastLevel; ++level)
+    {
+        if (_pLoadLevels[level])
+        {
+            for (uint32_t image = 0u; image < imagesPerLevel; ++image)
+            {
+                maxSliceSize = max(maxSliceSize, getSliceSize(_image.m_basisLZ.pImageDescs[level * imagesPerLevel + image]));
+            }
+
+            imageCount += imagesPerLevel;
         }
     }
 
-    if (_image.allocateMipLevelArray() != Result::Success)
+    if (imageCount == 0u)
     {
-        return false;
+        return true;
     }
 
-    const Header& ktx = _image.getHeader();
-    const uint32_t levelCount = _image.getLevelCount();
-    const uint32_t faceCount = _image.getFaceCount();
-    const uint32_t layerCount = _image.getLayerCount();
+    // animated etc1s frames depend on the previous frame and have to be decoded in order with the same state
+    const bool sequential = m_isETC1S && m_isAnimation;
+    const uint32_t batchSize = sequential ? 1u : min(StreamBatchSize, imageCount);
 
-    const LevelIndex& baseLevel = _image.m_pLevels[0u];
-    uint8_t* pLevelData = _image.allocateArray<uint8_t>(baseLevel.byteLength);
-    if (pLevelData == nullptr)
+    uint32_t* pImages = _image.allocateArray<uint32_t>(imageCount);
+    uint8_t* pSlices = _image.allocateArray<uint8_t>(static_cast<size_t>(max<uint64_t>(batchSize * maxSliceSize, 1u)));
+
+    if (pImages == nullptr || pSlices == nullptr)
     {
+        if (pImages != nullptr)
+        {
+            _image.free(pImages);
+        }
+        if (pSlices != nullptr)
+        {
+            _image.free(pSlices);
+        }
         return false;
     }
 
-    for(uint32_t level = 0u, image = 0u; level < levelCount; ++level)
+    // images in file index order
+    uint32_t imageCounter = 0u;
+    for (uint32_t level = _firstLevel; level <= _lastLevel; ++level)
     {
-        const LevelIndex& lvl = _image.m_pLevels[level];
-        const uint64_t faceSize = getFaceSize(ktx.vkFormat, level, ktx.pixelWidth, ktx.pixelHeight, ktx.pixelDepth);
+        if (_pLoadLevels[level])
+        {
+            for (uint32_t image = 0u; image < imagesPerLevel; ++image)
+            {
+                pImages[imageCounter++] = level * imagesPerLevel + image;
+            }
+        }
+    }
 
-        basist::basisu_image_desc imageDesc(
-            isETC1S ? basist::basis_tex_format::cETC1S : basist::basis_tex_format::cUASTC4x4,
-            max(1u, ktx.pixelWidth >> level),
-            max(1u, ktx.pixelHeight >> level),
-            level);
+    basist::basisu_transcoder_state sharedState;
 
-        if (_image.seek(_file, lvl.byteOffset) == false)
+    struct StreamTask
+    {
+        BasisTranscoder* pTranscoder;
+        SlimKTX2* pImage;
+        const uint32_t* pImages;
+        uint8_t* pSlices;
+        uint64_t maxSliceSize;
+        uint32_t imagesPerLevel;
+        uint32_t faceCount;
+        uint32_t batchStart;
+        bool readInTask;
+        basist::basisu_transcoder_state* pSharedState;
+        std::atomic<bool> failed;
+    } task{ this, &_image, pImages, pSlices, maxSliceSize, imagesPerLevel, faceCount, 0u,
+        // positional reads can be issued from the tasks, otherwise the slices of a batch are read up front
+        _image.m_callbacks.readAt != nullptr,
+        sequential ? &sharedState : nullptr, { false } };
+
+    for (uint32_t batchStart = 0u; batchStart < imageCount && task.failed == false; batchStart += batchSize)
+    {
+        const uint32_t count = min(batchSize, imageCount - batchStart);
+        task.batchStart = batchStart;
+
+        if (task.readInTask == false)
         {
-            return false;
+            for (uint32_t i = 0u; i < count; ++i)
+            {
+                if (readSlices(_image, pImages[batchStart + i], pSlices + i * maxSliceSize) == false)
+                {
+                    task.failed = true;
+                    break;
+                }
+            }
         }
 
-        // read the whole level array
-        if (_image.read(_file, pLevelData, lvl.byteLength) == false)
+        if (task.failed)
         {
-            return false;
+            break;
         }
 
-        for (uint32_t layer = 0; layer < layerCount; ++layer)
+        _image.parallelFor(count, [](void* _pTaskData, uint32_t _index)
         {
-            for (uint32_t face = 0; face < faceCount; ++face, ++image)
+            StreamTask& task = *static_cast<StreamTask*>(_pTaskData);
+            BasisTranscoder& transcoder = *task.pTranscoder;
+
+            const uint32_t imageIndex = task.pImages[task.batchStart + _index];
+            uint8_t* pSlice = task.pSlices + _index * task.maxSliceSize;
+
+            if (task.readInTask && transcoder.readSlices(*task.pImage, imageIndex, pSlice) == false)
             {
-                const auto& basisImg = _image.m_basisLZ.pImageDescs[image];
-                imageDesc.m_rgb_byte_offset = basisImg.rgbSliceByteOffset;
-                imageDesc.m_rgb_byte_length = basisImg.rgbSliceByteLength;
-                imageDesc.m_flags = basisImg.imageFlags;
+                task.failed = true;
+                return;
+            }
 
-                if (alphaContent != eNone)
-                {
-                    imageDesc.m_alpha_byte_offset = basisImg.alphaSliceByteOffset;
-                    imageDesc.m_alpha_byte_length = basisImg.alphaSliceByteLength;
-                }
+            // slices are stored back to back in the slice buffer
+            BasisLZ::ImageDesc desc = task.pImage->m_basisLZ.pImageDescs[imageIndex];
+            desc.rgbSliceByteOffset = 0u;
+            desc.alphaSliceByteOffset = desc.rgbSliceByteLength;
 
-                uint8_t* pDecoded = nullptr;
-                if (_image.getImage(pDecoded, level, face, layer, static_cast<uint32_t>(faceSize)) != Result::Success)
-                {
-                    return false;
-                }
+            const uint32_t level = imageIndex / task.imagesPerLevel;
+            const uint32_t image = imageIndex % task.imagesPerLevel;
 
-                if (isETC1S)
-                {
-					if (bit.transcode_image(targetFormat, pDecoded, static_cast<uint32_t>(faceSize), pLevelData, imageDesc, transcodeFlags) == false)
-					{
-						return false;
-					}                
-                }
-                else if (isUASTC)
-                {
-                    if (uit.transcode_image(targetFormat, pDecoded, static_cast<uint32_t>(faceSize), pLevelData, imageDesc, transcodeFlags, alphaContent != eNone) == false)
-                    {
-                        return false;
-                    }
-                }
+            basist::basisu_transcoder_state state;
+            basist::basisu_transcoder_state* pState = task.pSharedState != nullptr ? task.pSharedState : &state;
+
+            if (transcoder.transcodeImage(*task.pImage, pSlice, transcoder.getSliceSize(desc), desc, level, image / task.faceCount, image % task.faceCount, pState) == false)
+            {
+                task.failed = true;
             }
+        }, &task);
+    }
+
+    _image.free(pSlices);
+    _image.free(pImages);
+
+    return task.failed == false;
+}
+
+uint64_t ux3d::slimktx2::BasisTranscoder::getSliceSize(const BasisLZ::ImageDesc& _desc) const
+{
+    return static_cast<uint64_t>(_desc.rgbSliceByteLength) + (m_alphaContent != AlphaContent_None ? _desc.alphaSliceByteLength : 0u);
+}
+
+bool ux3d::slimktx2::BasisTranscoder::readSlices(SlimKTX2& _image, uint32_t _imageIndex, uint8_t* _pDst) const
+{
+    const uint32_t level = _imageIndex / (_image.getFaceCount() * _image.getLayerCount());
+    const LevelIndex& lvl = _image.m_pLevels[level];
+    const BasisLZ::ImageDesc& desc = _image.m_basisLZ.pImageDescs[_imageIndex];
+
+    // slice offsets are relative to the level
+    if (static_cast<uint64_t>(desc.rgbSliceByteOffset) + desc.rgbSliceByteLength > lvl.byteLength ||
+        _image.readAt(_image.m_file, static_cast<size_t>(lvl.byteOffset + desc.rgbSliceByteOffset), _pDst, desc.rgbSliceByteLength) == false)
+    {
+        return false;
+    }
+
+    if (m_alphaContent != AlphaContent_None && desc.alphaSliceByteLength != 0u)
+    {
+        if (static_cast<uint64_t>(desc.alphaSliceByteOffset) + desc.alphaSliceByteLength > lvl.byteLength ||
+            _image.readAt(_image.m_file, static_cast<size_t>(lvl.byteOffset + desc.alphaSliceByteOffset), _pDst + desc.rgbSliceByteLength, desc.alphaSliceByteLength) == false)
+        {
+            return false;
         }
     }
 
-    _image.free(pLevelData);
-    
-    // TODO: update DFD with new color model
+    return true;
+}
+
+ux3d::slimktx2::BasisLZ::ImageDesc ux3d::slimktx2::BasisTranscoder::getImageDesc(const SlimKTX2& _image, uint32_t _imageIndex) const
+{
+    if (m_isBasisLZ)
+    {
+        return _image.m_basisLZ.pImageDescs[_imageIndex];
+    }
+
+    const uint32_t imagesPerLevel = _image.getFaceCount() * _image.getLayerCount();
+    const uint32_t imageSize = static_cast<uint32_t>(_image.getUASTCLevelSize(_imageIndex / imagesPerLevel) / imagesPerLevel);
+
+    BasisLZ::ImageDesc desc{};
+    desc.rgbSliceByteOffset = (_imageIndex % imagesPerLevel) * imageSize;
+    desc.rgbSliceByteLength = imageSize;
+
+    return desc;
+}
+
+uint64_t ux3d::slimktx2::BasisTranscoder::getLevelDataSize(const SlimKTX2& _image, uint32_t _level) const
+{
+    // UASTC levels were checked against the block size when read (zstd levels are decompressed first)
+    return m_isBasisLZ ? _image.m_pLevels[_level].byteLength : _image.getUASTCLevelSize(_level);
+}
+
+bool ux3d::slimktx2::BasisTranscoder::transcodeRegion(SlimKTX2& _image, uint32_t _level, uint32_t _face, uint32_t _layer, uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height, uint8_t* _pDst, uint64_t _dstRowPitch)
+{
+    const Header& ktx = _image.getHeader();
+    const uint32_t faceCount = _image.getFaceCount();
+    const uint32_t layerCount = _image.getLayerCount();
+    const uint32_t levelWidth = max(1u, ktx.pixelWidth >> _level);
+    const uint32_t levelHeight = max(1u, ktx.pixelHeight >> _level);
+
+    if (m_isETC1S)
+    {
+        // etc1s images are a single huffman coded stream, the whole image has to be decoded.
+        // p-frames of animations depend on the previous layer, decode all layers up to _layer in order
+        const uint32_t firstLayer = m_isAnimation ? 0u : _layer;
+
+        const uint64_t imageSize = getFaceSize(ktx.vkFormat, _level, ktx.pixelWidth, ktx.pixelHeight);
+
+        uint64_t maxSliceSize = 0u;
+        for (uint32_t layer = firstLayer; layer <= _layer; ++layer)
+        {
+            maxSliceSize = max(maxSliceSize, getSliceSize(_image.m_basisLZ.pImageDescs[(_level * layerCount + layer) * faceCount + _face]));
+        }
+
+        uint8_t* pSlices = _image.allocateArray<uint8_t>(static_cast<size_t>(max<uint64_t>(maxSliceSize, 1u)));
+        uint8_t* pDecoded = _image.allocateArray<uint8_t>(static_cast<size_t>(imageSize));
+
+        bool success = pSlices != nullptr && pDecoded != nullptr;
+
+        basist::basisu_transcoder_state state;
+        for (uint32_t layer = firstLayer; layer <= _layer && success; ++layer)
+        {
+            const uint32_t imageIndex = (_level * layerCount + layer) * faceCount + _face;
+
+            // slices are stored back to back in the slice buffer
+            BasisLZ::ImageDesc desc = _image.m_basisLZ.pImageDescs[imageIndex];
+            desc.rgbSliceByteOffset = 0u;
+            desc.alphaSliceByteOffset = desc.rgbSliceByteLength;
+
+            success = readSlices(_image, imageIndex, pSlices) &&
+                transcodeSlices(pSlices, getSliceSize(desc), desc, levelWidth, levelHeight, _level, pDecoded, imageSize, &state);
+        }
+
+        if (success)
+        {
+            copyRegion(ktx.vkFormat, pDecoded, levelWidth, _x, _y, _width, _height, _pDst, _dstRowPitch);
+        }
+
+        if (pSlices != nullptr)
+        {
+            _image.free(pSlices);
+        }
+        if (pDecoded != nullptr)
+        {
+            _image.free(pDecoded);
+        }
+
+        return success;
+    }
+
+    // uastc: 16 byte 4x4 blocks in row major order, gather the blocks of the region to a compact slice
+    const uint32_t uastcBlockSize = 16u;
+    const uint32_t levelBlockCountX = (levelWidth + 3u) / 4u;
+    const uint32_t levelBlockCountY = (levelHeight + 3u) / 4u;
+    const uint32_t blockCountX = (_width + 3u) / 4u;
+    const uint32_t blockCountY = (_height + 3u) / 4u;
+
+    const uint32_t imageIndex = (_level * layerCount + _layer) * faceCount + _face;
+    const BasisLZ::ImageDesc imageDesc = getImageDesc(_image, imageIndex);
+    const LevelIndex& lvl = _image.m_pLevels[_level];
+
+    if (static_cast<uint64_t>(imageDesc.rgbSliceByteLength) < static_cast<uint64_t>(levelBlockCountX) * levelBlockCountY * uastcBlockSize ||
+        static_cast<uint64_t>(imageDesc.rgbSliceByteOffset) + imageDesc.rgbSliceByteLength > lvl.byteLength)
+    {
+        return false;
+    }
+
+    const uint64_t rowPitch = getRowPitch(ktx.vkFormat, _width);
+    const uint64_t regionSize = getFaceSize(ktx.vkFormat, 0u, _width, _height);
+    const bool packed = _dstRowPitch == rowPitch;
+
+    const uint32_t sliceSize = blockCountX * blockCountY * uastcBlockSize;
+    uint8_t* pSlice = _image.allocateArray<uint8_t>(sliceSize);
+    uint8_t* pDecoded = packed ? _pDst : _image.allocateArray<uint8_t>(static_cast<size_t>(regionSize));
+
+    bool success = pSlice != nullptr && pDecoded != nullptr;
+
+    const uint64_t sliceOffset = lvl.byteOffset + imageDesc.rgbSliceByteOffset;
+    for (uint32_t row = 0u; row < blockCountY && success; ++row)
+    {
+        const uint64_t blockIndex = static_cast<uint64_t>(_y / 4u + row) * levelBlockCountX + _x / 4u;
+        success = _image.readAt(_image.m_file, static_cast<size_t>(sliceOffset + blockIndex * uastcBlockSize), pSlice + row * blockCountX * uastcBlockSize, blockCountX * uastcBlockSize);
+    }
+
+    if (success)
+    {
+        BasisLZ::ImageDesc desc{};
+        desc.imageFlags = imageDesc.imageFlags;
+        desc.rgbSliceByteLength = sliceSize;
+
+        success = transcodeSlices(pSlice, sliceSize, desc, _width, _height, _level, pDecoded, regionSize, nullptr);
+    }
+
+    if (success && packed == false)
+    {
+        copyRegion(ktx.vkFormat, pDecoded, _width, 0u, 0u, _width, _height, _pDst, _dstRowPitch);
+    }
 
-	return true;
+    if (pSlice != nullptr)
+    {
+        _image.free(pSlice);
+    }
+    if (pDecoded != nullptr && packed == false)
+    {
+        _image.free(pDecoded);
+    }
+
+    return success;
+}
+
+bool ux3d::slimktx2::BasisTranscoder::transcodeImage(SlimKTX2& _image, const uint8_t* _pData, uint64_t _dataSize, const BasisLZ::ImageDesc& _desc, uint32_t _level, uint32_t _layer, uint32_t _face, basist::basisu_transcoder_state* _pState)
+{
+    const Header& ktx = _image.getHeader();
+    const uint64_t faceSize = getFaceSize(ktx.vkFormat, _level, ktx.pixelWidth, ktx.pixelHeight, ktx.pixelDepth);
+
+    uint8_t* pDecoded = nullptr;
+    if (_image.getImage(pDecoded, _level, _face, _layer, static_cast<uint32_t>(faceSize)) != Result::Success)
+    {
+        return false;
+    }
+
+    return transcodeSlices(_pData, _dataSize, _desc, max(1u, ktx.pixelWidth >> _level), max(1u, ktx.pixelHeight >> _level), _level, pDecoded, faceSize, _pState);
 }
 
+bool ux3d::slimktx2::BasisTranscoder::transcodeSlices(const uint8_t* _pData, uint64_t _dataSize, const BasisLZ::ImageDesc& _desc, uint32_t _width, uint32_t _height, uint32_t _level, uint8_t* _pDst, uint64_t _dstSize, basist::basisu_transcoder_state* _pState)
+{
+    const auto targetFormat = static_cast<basist::transcoder_texture_format>(m_targetFormat);
+
+    basist::basisu_image_desc imageDesc(
+        m_isETC1S ? basist::basis_tex_format::cETC1S : basist::basis_tex_format::cUASTC4x4,
+        _width,
+        _height,
+        _level);
+
+    if (static_cast<uint64_t>(_desc.rgbSliceByteOffset) + _desc.rgbSliceByteLength > _dataSize)
+    {
+        return false;
+    }
+
+    imageDesc.m_rgb_byte_offset = _desc.rgbSliceByteOffset;
+    imageDesc.m_rgb_byte_length = _desc.rgbSliceByteLength;
+    imageDesc.m_flags = _desc.imageFlags;
+
+    if (m_alphaContent != AlphaContent_None)
+    {
+        if (static_cast<uint64_t>(_desc.alphaSliceByteOffset) + _desc.alphaSliceByteLength > _dataSize)
+        {
+            return false;
+        }
+
+        imageDesc.m_alpha_byte_offset = _desc.alphaSliceByteOffset;
+        imageDesc.m_alpha_byte_length = _desc.alphaSliceByteLength;
+    }
+
+    if (m_isETC1S)
+    {
+        return m_pETC1S->transcode_image(targetFormat, _pDst, static_cast<uint32_t>(_dstSize), _pData, imageDesc, m_transcodeFlags, 0u, 0u, _pState);
+    }
+
+    return m_uastc.transcode_image(targetFormat, _pDst, static_cast<uint32_t>(_dstSize), _pData, imageDesc, m_transcodeFlags, m_alphaContent != AlphaContent_None);
+}
@@ -4,6 +4,8 @@
 
 #include "callbacks.h"
 #include "format.h"
+#include "transcodercontext.h"
+#include <transcoder/basisu_transcoder.h>
 
 namespace ux3d
 {
@@ -12,16 +14,108 @@ namespace ux3d
 		// forward decl
 		class SlimKTX2;
 
+		struct TranscoderContext::Codebook
+		{
+			Codebook();
+
+			basist::basisu_etc1s_image_transcoder etc1s;
+
+			enum class State : uint32_t
+			{
+				Decoding, // by the thread that inserted it, others wait on TranscoderContext::m_decoded
+				Decoded,
+				Failed
+			};
+
+			uint64_t hash = 0u;
+			BasisLZ::Header header{};
+
+			// copy of endpoints, selectors and tables (in this order), compared on hash hits
+			uint8_t* pData = nullptr;
+
+			State state = State::Decoding;
+			uint32_t refCount = 0u;
+			Codebook* pNext = nullptr;
+		};
+
 		class BasisTranscoder
 		{
 		public:
 			BasisTranscoder();
 			~BasisTranscoder();
 
-			bool decompress(SlimKTX2& _image, IOHandle _file, TranscodeFormat _targetFormat);
+			// validates the dfd, decodes etc1s palettes and tables and sets the vkFormat of _image to the transcoded format.
+			// _transcodeFlags (TranscodeFlag bits) are passed to basisu for every image.
+			// with _pContext the decoded palettes and tables are shared with other files using the same codebooks
+			bool init(SlimKTX2& _image, TranscodeFormat _targetFormat, uint32_t _transcodeFlags = 0u, TranscoderContext* _pContext = nullptr);
+
+			// calls basisu_transcoder_init once per process
+			static void initBasisu();
+
+			static const basist::etc1_global_selector_codebook* getGlobalSelectorCodebook();
+
+			// hash of the codebook relevant parts of the sgd (header, palettes and tables)
+			static uint64_t hashCodebook(const BasisLZ& _basisLZ);
+
+			static bool decodeCodebook(basist::basisu_etc1s_image_transcoder& _etc1s, const BasisLZ& _basisLZ);
+
+			// transcodes all images of the levels with compressed data in _pCompressedLevels, levels have to be allocated in the mip level array of _image.
+			// images are transcoded in parallel via the parallelFor callback of _image
+			bool decompressLevels(SlimKTX2& _image, uint8_t* const* _pCompressedLevels, uint32_t _firstLevel, uint32_t _lastLevel);
+
+			// transcodes all images of the levels flagged in _pLoadLevels, the compressed slices are read from the file of _image image by image.
+			// at most StreamBatchSize images are in flight, which bounds the compressed data held in memory
+			bool streamLevels(SlimKTX2& _image, const bool* _pLoadLevels, uint32_t _firstLevel, uint32_t _lastLevel);
+
+			static constexpr uint32_t StreamBatchSize = 16u;
+
+			// transcodes the _width x _height pixel rectangle at _x, _y (multiples of 4) of an image to _pDst, block rows are _dstRowPitch bytes apart.
+			// the slices are read from the file of _image. uastc blocks are independent and only the blocks of the rectangle are transcoded,
+			// etc1s images are transcoded as a whole to a temporary buffer (animations from the first layer on)
+			bool transcodeRegion(SlimKTX2& _image, uint32_t _level, uint32_t _face, uint32_t _layer, uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height, uint8_t* _pDst, uint64_t _dstRowPitch);
 
 		private:
+			// transcodes a single image, slice offsets of _desc are relative to _pData. _pState holds the etc1s decoder state which must not be shared between threads
+			bool transcodeImage(SlimKTX2& _image, const uint8_t* _pData, uint64_t _dataSize, const BasisLZ::ImageDesc& _desc, uint32_t _level, uint32_t _layer, uint32_t _face, basist::basisu_transcoder_state* _pState);
+
+			// transcodes the slices of _desc describing a _width x _height image to _pDst
+			bool transcodeSlices(const uint8_t* _pData, uint64_t _dataSize, const BasisLZ::ImageDesc& _desc, uint32_t _width, uint32_t _height, uint32_t _level, uint8_t* _pDst, uint64_t _dstSize, basist::basisu_transcoder_state* _pState);
+
+			// compressed size of an image as read by readSlices
+			uint64_t getSliceSize(const BasisLZ::ImageDesc& _desc) const;
+
+			// reads the rgb slice followed by the alpha slice of image _imageIndex to _pDst
+			bool readSlices(SlimKTX2& _image, uint32_t _imageIndex, uint8_t* _pDst) const;
+
+			// image desc of the sgd. UASTC files without BasisLZ have none, their images are stored back to back in the level
+			BasisLZ::ImageDesc getImageDesc(const SlimKTX2& _image, uint32_t _imageIndex) const;
+
+			// size of the level data the image descs refer to
+			uint64_t getLevelDataSize(const SlimKTX2& _image, uint32_t _level) const;
+
+			enum AlphaContent
+			{
+				AlphaContent_None,
+				AlphaContent_Alpha,
+				AlphaContent_Green
+			};
+
+			// used without context, m_pETC1S points to it or to the codebook of m_pContext
+			basist::basisu_etc1s_image_transcoder m_etc1s;
+			basist::basisu_etc1s_image_transcoder* m_pETC1S = nullptr;
+			basist::basisu_uastc_image_transcoder m_uastc;
+
+			TranscoderContext* m_pContext = nullptr;
+			TranscoderContext::Codebook* m_pCodebook = nullptr;
+
+			TranscodeFormat m_targetFormat = TranscodeFormat::UNDEFINED;
+			uint32_t m_transcodeFlags = 0u;
+			AlphaContent m_alphaContent = AlphaContent_None;
+			bool m_isETC1S = false;
+			bool m_isBasisLZ = false;
 
+			// animated etc1s files may contain p-frames which depend on the previous layer
+			bool m_isAnimation = false;
 		};
 	}
-}
\ No newline at end of file
+}
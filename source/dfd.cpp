@@ -2,9 +2,29 @@
 
 #include "dfd.h"
 #include <cstddef>
+#include <cstring>
 
 using namespace ux3d::slimktx2;
 
+namespace
+{
+	bool getBlockAt(const DataFormatDesc& _dfd, uint32_t _byteOffset, DataFormatDesc::Block& _block)
+	{
+		// validate accepts less than a block header of trailing bytes after the last block
+		if (_dfd.pData == nullptr || static_cast<uint64_t>(_byteOffset) + DataFormatDesc::blockHeaderSize > _dfd.totalSize)
+		{
+			return false;
+		}
+
+		// headers are not necessarily 8 byte aligned in the buffer, copy it
+		memcpy(&_block.header, _dfd.pData + _byteOffset, DataFormatDesc::blockHeaderSize);
+		_block.byteOffset = _byteOffset;
+		_block.pSamples = _block.getSampleCount() != 0u ? reinterpret_cast<const DataFormatDesc::Sample*>(_dfd.pData + _byteOffset + DataFormatDesc::blockHeaderSize) : nullptr;
+
+		return true;
+	}
+} // !namespace
+
 DataFormatDesc::BlockHeader::BlockHeader() :
 	vendorId(VendorId_KHRONOS),
 	type(DescriptorType_BASICFORMAT),
@@ -31,35 +51,51 @@ DataFormatDesc::BlockHeader::BlockHeader() :
 
 uint32_t DataFormatDesc::computeSize() const
 {
-	size_t size = sizeof(uint32_t); // totalSize member
-
-	const Block* pBlock = pBlocks;
-	while (pBlock != nullptr)
-	{
-		size += blockHeaderSize;
-
-		if (pBlock->pSamples != nullptr)
-		{
-			size += static_cast<uint64_t>(pBlock->getSampleCount())* sampleSize;
-		}
+	return pData != nullptr ? totalSize : static_cast<uint32_t>(sizeof(uint32_t)); // totalSize member
+}
 
-		pBlock = pBlock->pNext;
-	};
+bool DataFormatDesc::getFirstBlock(Block& _block) const
+{
+	return blockCount != 0u && getBlockAt(*this, sizeof(uint32_t), _block);
+}
 
-	return static_cast<uint32_t>(size);
+bool DataFormatDesc::getNextBlock(Block& _block) const
+{
+	return getBlockAt(*this, _block.byteOffset + _block.header.blockSize, _block);
 }
 
-ux3d::slimktx2::DataFormatDesc::Block* ux3d::slimktx2::DataFormatDesc::getLastBlock() const
+bool DataFormatDesc::validate(uint32_t _byteSize)
 {
-	Block* pBlock = pBlocks;
-	while (pBlock != nullptr)
+	blockCount = 0u;
+	totalSize = 0u;
+
+	if (pData == nullptr || _byteSize < sizeof(uint32_t))
 	{
-		if (pBlock->pNext == nullptr)
+		return false;
+	}
+
+	memcpy(&totalSize, pData, sizeof(uint32_t));
+
+	if (totalSize < sizeof(uint32_t) || totalSize > _byteSize)
+	{
+		return false;
+	}
+
+	uint32_t offset = sizeof(uint32_t);
+	while (totalSize - offset >= blockHeaderSize)
+	{
+		BlockHeader header;
+		memcpy(&header, pData + offset, blockHeaderSize);
+
+		// samples have to fit into the block and stay 4 byte aligned
+		if (header.blockSize < blockHeaderSize || header.blockSize > totalSize - offset || header.blockSize % sizeof(uint32_t) != 0u)
 		{
-			break;
+			return false;
 		}
-		pBlock = pBlock->pNext;
+
+		offset += header.blockSize;
+		++blockCount;
 	}
 
-	return pBlock;
+	return true;
 }
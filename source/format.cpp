@@ -2,6 +2,7 @@
 
 #include "format.h"
 #include <cmath>
+#include <cstring>
 
 uint32_t ux3d::slimktx2::getTypeSize(ux3d::slimktx2::Format _vkFormat)
 {
@@ -1115,6 +1116,33 @@ uint64_t ux3d::slimktx2::getFaceSize(Format _vkFormat, uint32_t _level, uint32_t
 	}
 }
 
+uint64_t ux3d::slimktx2::getRowPitch(Format _vkFormat, uint32_t _width)
+{
+	uint32_t blockWidth = 1u;
+	uint32_t blockHeight = 1u;
+	getBlockSize(_vkFormat, blockWidth, blockHeight);
+
+	return static_cast<uint64_t>(getFormatSize(_vkFormat)) * ((_width + blockWidth - 1u) / blockWidth);
+}
+
+void ux3d::slimktx2::copyRegion(Format _vkFormat, const uint8_t* _pSrc, uint32_t _srcWidth, uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height, uint8_t* _pDst, uint64_t _dstRowPitch)
+{
+	uint32_t blockWidth = 1u;
+	uint32_t blockHeight = 1u;
+	getBlockSize(_vkFormat, blockWidth, blockHeight);
+
+	const uint64_t srcRowPitch = getRowPitch(_vkFormat, _srcWidth);
+	const uint64_t rowSize = getRowPitch(_vkFormat, _width);
+	const uint32_t rowCount = (_height + blockHeight - 1u) / blockHeight;
+
+	const uint8_t* pSrc = _pSrc + (_y / blockHeight) * srcRowPitch + (_x / blockWidth) * static_cast<uint64_t>(getFormatSize(_vkFormat));
+
+	for (uint32_t row = 0u; row < rowCount; ++row)
+	{
+		memcpy(_pDst + row * _dstRowPitch, pSrc + row * srcRowPitch, static_cast<size_t>(rowSize));
+	}
+}
+
 uint32_t ux3d::slimktx2::getPixelCount(uint32_t _level, uint32_t _width, uint32_t _height, uint32_t _depth)
 {
 	uint32_t result = _width >> _level;
@@ -1203,11 +1231,23 @@ ux3d::slimktx2::Format ux3d::slimktx2::transcodeToVkFormat(TranscodeFormat _form
 		return Format::B5G6R5_UNORM_PACK16;
 	case TranscodeFormat::RGBA4444:
 		return Format::R4G4B4A4_UNORM_PACK16;
-	//case TranscodeFormat::ETC:
-	//	break;
-	//case TranscodeFormat::BC1_OR_3:
-	//	break;
+	case TranscodeFormat::ETC:
+	case TranscodeFormat::BC1_OR_3:
+		// has to be resolved with resolveTranscodeFormat first
 	default:
 		return Format::UNDEFINED;
 	}
 }
+
+ux3d::slimktx2::TranscodeFormat ux3d::slimktx2::resolveTranscodeFormat(TranscodeFormat _format, bool _hasAlpha)
+{
+	switch (_format)
+	{
+	case TranscodeFormat::ETC:
+		return _hasAlpha ? TranscodeFormat::ETC2_RGBA : TranscodeFormat::ETC1_RGB;
+	case TranscodeFormat::BC1_OR_3:
+		return _hasAlpha ? TranscodeFormat::BC3_RGBA : TranscodeFormat::BC1_RGB;
+	default:
+		return _format;
+	}
+}
@@ -26,25 +26,131 @@ uint32_t KeyValueData::computeSize() const
 
 KeyValueData::Entry* KeyValueData::getLastEntry() const
 {
-	Entry* pEntry = pKeyValues;
-	while (pEntry != nullptr)
+	return pLastEntry;
+}
+
+void KeyValueData::append(Entry* _pEntry)
+{
+	if (pLastEntry == nullptr) // first entry
+	{
+		pKeyValues = _pEntry;
+	}
+	else
+	{
+		pLastEntry->pNext = _pEntry;
+	}
+
+	pLastEntry = _pEntry;
+}
+
+void KeyValueData::addToIndex(Entry* _pEntry)
+{
+	uint32_t length = 0u;
+	if (_pEntry->pKeyValue != nullptr)
+	{
+		for (; length < _pEntry->keyAndValueByteLength && _pEntry->pKeyValue[length] != 0u; ++length) {}
+	}
+
+	_pEntry->keyLength = length;
+	_pEntry->keyHash = hashKey(_pEntry->pKeyValue, length);
+
+	Entry*& pBucket = pBuckets[_pEntry->keyHash & (BucketCount - 1u)];
+	_pEntry->pNextInBucket = pBucket;
+	pBucket = _pEntry;
+}
+
+const KeyValueData::Entry* KeyValueData::findEntry(const char* _key) const
+{
+	const uint32_t keyLength = static_cast<uint32_t>(strlen(_key));
+	const uint32_t keyHash = hashKey(reinterpret_cast<const uint8_t*>(_key), keyLength);
+
+	for (const Entry* pEntry = pBuckets[keyHash & (BucketCount - 1u)]; pEntry != nullptr; pEntry = pEntry->pNextInBucket)
+	{
+		if (pEntry->keyHash == keyHash && pEntry->keyLength == keyLength && memcmp(pEntry->pKeyValue, _key, keyLength) == 0)
+		{
+			return pEntry;
+		}
+	}
+
+	return nullptr;
+}
+
+const uint8_t* KeyValueData::findValue(const char* _key, uint32_t* _pValueLength) const
+{
+	const Entry* pEntry = findEntry(_key);
+
+	const uint8_t* pValue = pEntry != nullptr ? pEntry->getValue() : nullptr;
+
+	if (_pValueLength != nullptr)
+	{
+		*_pValueLength = pValue != nullptr ? pEntry->keyAndValueByteLength - pEntry->keyLength - 1u : 0u;
+	}
+
+	return pValue;
+}
+
+uint32_t KeyValueData::hashKey(const uint8_t* _pKey, uint32_t _keyLength)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0u; i < _keyLength; ++i)
+	{
+		hash ^= _pKey[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+const uint8_t* KeyValueData::findRawValue(const uint8_t* _pData, uint32_t _byteLength, const char* _key, uint32_t* _pValueLength)
+{
+	const uint32_t keyLength = static_cast<uint32_t>(strlen(_key));
+
+	const uint8_t* pValue = nullptr;
+	uint32_t valueLength = 0u;
+
+	uint64_t offset = 0u;
+	while (_pData != nullptr && offset + sizeof(uint32_t) <= _byteLength)
 	{
-		if (pEntry->pNext == nullptr)
+		uint32_t keyAndValueByteLength = 0u;
+		memcpy(&keyAndValueByteLength, _pData + offset, sizeof(uint32_t));
+		offset += sizeof(uint32_t);
+
+		if (offset + keyAndValueByteLength > _byteLength)
 		{
 			break;
 		}
-		pEntry = pEntry->pNext;
+
+		const uint8_t* pKeyValue = _pData + offset;
+		if (keyAndValueByteLength > keyLength && pKeyValue[keyLength] == 0u && memcmp(pKeyValue, _key, keyLength) == 0)
+		{
+			// keep going, with duplicate keys the last one wins like in findValue
+			pValue = pKeyValue + keyLength + 1u;
+			valueLength = keyAndValueByteLength - keyLength - 1u;
+		}
+
+		offset += keyAndValueByteLength + getPadding(keyAndValueByteLength, 4u);
+	}
+
+	if (_pValueLength != nullptr)
+	{
+		*_pValueLength = valueLength;
 	}
 
-	return pEntry;
+	return pValue;
 }
 
 uint32_t KeyValueData::Entry::getKeyLength() const
 {
+	// the hash of a cached key is never 0 (not even for an empty key), entries that were not indexed are scanned
+	if (keyLength != 0u || keyHash != 0u)
+	{
+		return keyLength;
+	}
+
 	uint32_t length = 0u;
 	if (pKeyValue != nullptr)
-	{		
-		for (; pKeyValue[length] != 0u && length < keyAndValueByteLength; ++length) {}
+	{
+		for (; length < keyAndValueByteLength && pKeyValue[length] != 0u; ++length) {}
 	}
 	return length;
 }
@@ -53,3 +159,15 @@ uint32_t KeyValueData::Entry::getValueLength() const
 {
 	return keyAndValueByteLength - getKeyLength();
 }
+
+const uint8_t* KeyValueData::Entry::getValue() const
+{
+	const uint32_t length = getKeyLength();
+
+	if (pKeyValue == nullptr || length + 1u > keyAndValueByteLength)
+	{
+		return nullptr;
+	}
+
+	return pKeyValue + length + 1u;
+}
@@ -1,10 +1,17 @@
 // Copyright (c) 2020 UX3D GmbH. All rights reserved.
 
 #include "slimktx2.h"
+#include "DefaultMemoryStreamCallback.h"
+#include <atomic>
 #include <cstring>
 
 #ifdef SLIMKTX2_USE_BASISU
 #include "basistranscoder.h"
+#include "transcodercontext.h"
+#endif
+
+#ifdef SLIMKTX2_USE_ZSTD
+#include "zstdcodec.h"
 #endif
 
 using namespace ux3d::slimktx2;
@@ -15,16 +22,47 @@ SlimKTX2::SlimKTX2(const Callbacks& _callbacks) : m_callbacks(_callbacks)
 {
 }
 
+uint32_t InspectInfo::getLevelCount() const
+{
+	return header.levelCount != 0u ? header.levelCount : 1u;
+}
+
+const uint8_t* InspectInfo::findValue(const char* _key, uint32_t* _pValueLength) const
+{
+	return KeyValueData::findRawValue(pKVD, sections.kvdByteLength, _key, _pValueLength);
+}
+
 SlimKTX2::~SlimKTX2()
 {
 	clear();
 }
 
+SlimKTX2::SlimKTX2(SlimKTX2&& _other)
+{
+	moveFrom(_other);
+}
+
+SlimKTX2& SlimKTX2::operator=(SlimKTX2&& _other)
+{
+	if (this != &_other)
+	{
+		clear();
+		moveFrom(_other);
+	}
+
+	return *this;
+}
+
 void SlimKTX2::setCallbacks(const Callbacks& _callbacks)
 {
 	m_callbacks = _callbacks;
 }
 
+void SlimKTX2::setTranscoderContext(TranscoderContext* _pContext)
+{
+	m_pTranscoderContext = _pContext;
+}
+
 void SlimKTX2::clear()
 {
 	// level index
@@ -41,6 +79,249 @@ void SlimKTX2::clear()
 	destroySGD();
 
 	destoryMipLevelArray();
+
+	destroyTranscoder();
+
+	destroySpares();
+
+	m_file = nullptr;
+}
+
+void SlimKTX2::setRetainCapacity(bool _enable)
+{
+	m_retainCapacity = _enable;
+
+	if (_enable == false)
+	{
+		destroySpares();
+	}
+}
+
+void SlimKTX2::reset()
+{
+	if (m_retainCapacity == false)
+	{
+		clear();
+		return;
+	}
+
+	const uint32_t levelCount = getLevelCount();
+
+	// keep the larger of the current and the spare arrays
+	if (m_pLevels != nullptr)
+	{
+		if (m_pSpareLevels == nullptr || levelCount > m_spareLevelCapacity)
+		{
+			if (m_pSpareLevels != nullptr)
+			{
+				free(m_pSpareLevels);
+			}
+
+			m_pSpareLevels = m_pLevels;
+			m_spareLevelCapacity = levelCount;
+		}
+		else
+		{
+			free(m_pLevels);
+		}
+
+		m_pLevels = nullptr;
+	}
+
+	if (m_pMipLevelArray != nullptr)
+	{
+		// mapped levels are owned by the caller
+		if (m_pStorage != nullptr)
+		{
+			retainLevelStorage(m_pStorage, m_storageSize);
+		}
+		else if (m_pMappedData == nullptr)
+		{
+			for (uint32_t level = 0u; level < levelCount; ++level)
+			{
+				if (m_pMipLevelArray[level] != nullptr)
+				{
+					retainLevelStorage(m_pMipLevelArray[level], getLevelSize(level));
+				}
+			}
+		}
+
+		if (m_pSpareMipLevelArray == nullptr || levelCount > m_spareMipLevelCapacity)
+		{
+			if (m_pSpareMipLevelArray != nullptr)
+			{
+				free(m_pSpareMipLevelArray);
+			}
+
+			m_pSpareMipLevelArray = m_pMipLevelArray;
+			m_spareMipLevelCapacity = levelCount;
+		}
+		else
+		{
+			free(m_pMipLevelArray);
+		}
+
+		m_pMipLevelArray = nullptr;
+	}
+	else if (m_pStorage != nullptr)
+	{
+		retainLevelStorage(m_pStorage, m_storageSize);
+	}
+
+	m_pStorage = nullptr;
+	m_storageSize = 0u;
+	m_pMappedData = nullptr;
+
+	destroyDFD();
+
+	destroyKVD();
+
+	destroySGD();
+
+	destroyTranscoder();
+
+	m_file = nullptr;
+}
+
+void SlimKTX2::moveFrom(SlimKTX2& _other)
+{
+	m_callbacks = _other.m_callbacks;
+
+	m_header = _other.m_header;
+	m_sections = _other.m_sections;
+	m_pLevels = _other.m_pLevels;
+	m_dfd = _other.m_dfd;
+	m_kvd = _other.m_kvd;
+	m_basisLZ = _other.m_basisLZ;
+
+	m_pMipLevelArray = _other.m_pMipLevelArray;
+	m_mipAlignment = _other.m_mipAlignment;
+	m_contiguousStorage = _other.m_contiguousStorage;
+	m_pStorage = _other.m_pStorage;
+	m_storageSize = _other.m_storageSize;
+	m_pMappedData = _other.m_pMappedData;
+
+	m_file = _other.m_file;
+	m_pSourceData = _other.m_pSourceData;
+	m_sourceByteSize = _other.m_sourceByteSize;
+
+	m_pTranscoder = _other.m_pTranscoder;
+	m_pTranscoderContext = _other.m_pTranscoderContext;
+
+	m_zstdCompressionLevel = _other.m_zstdCompressionLevel;
+	m_pUserWriteBuffer = _other.m_pUserWriteBuffer;
+	m_userWriteBufferSize = _other.m_userWriteBufferSize;
+
+	m_retainCapacity = _other.m_retainCapacity;
+	m_pSpareLevels = _other.m_pSpareLevels;
+	m_spareLevelCapacity = _other.m_spareLevelCapacity;
+	m_pSpareMipLevelArray = _other.m_pSpareMipLevelArray;
+	m_spareMipLevelCapacity = _other.m_spareMipLevelCapacity;
+	m_spareLevelStorageCount = _other.m_spareLevelStorageCount;
+	for (uint32_t i = 0u; i < m_spareLevelStorageCount; ++i)
+	{
+		m_pSpareLevelStorage[i] = _other.m_pSpareLevelStorage[i];
+		m_spareLevelStorageSize[i] = _other.m_spareLevelStorageSize[i];
+	}
+
+	// _other keeps its callbacks and settings but owns nothing
+	_other.m_header = Header{};
+	_other.m_sections = SectionIndex{};
+	_other.m_pLevels = nullptr;
+	_other.m_dfd = DataFormatDesc{};
+	_other.m_kvd = KeyValueData{};
+	_other.m_basisLZ = BasisLZ{};
+	_other.m_pMipLevelArray = nullptr;
+	_other.m_pStorage = nullptr;
+	_other.m_storageSize = 0u;
+	_other.m_pMappedData = nullptr;
+	_other.m_file = nullptr;
+	_other.m_pSourceData = nullptr;
+	_other.m_sourceByteSize = 0u;
+	_other.m_pTranscoder = nullptr;
+	_other.m_pSpareLevels = nullptr;
+	_other.m_spareLevelCapacity = 0u;
+	_other.m_pSpareMipLevelArray = nullptr;
+	_other.m_spareMipLevelCapacity = 0u;
+	_other.m_spareLevelStorageCount = 0u;
+}
+
+void SlimKTX2::destroySpares()
+{
+	if (m_pSpareLevels != nullptr)
+	{
+		free(m_pSpareLevels);
+		m_pSpareLevels = nullptr;
+	}
+	m_spareLevelCapacity = 0u;
+
+	if (m_pSpareMipLevelArray != nullptr)
+	{
+		free(m_pSpareMipLevelArray);
+		m_pSpareMipLevelArray = nullptr;
+	}
+	m_spareMipLevelCapacity = 0u;
+
+	for (uint32_t i = 0u; i < m_spareLevelStorageCount; ++i)
+	{
+		freeLevelStorage(m_pSpareLevelStorage[i]);
+	}
+	m_spareLevelStorageCount = 0u;
+}
+
+void SlimKTX2::retainLevelStorage(uint8_t* _pData, uint64_t _byteSize)
+{
+	if (m_spareLevelStorageCount == MaxSpareLevelStorage)
+	{
+		freeLevelStorage(_pData);
+		return;
+	}
+
+	m_pSpareLevelStorage[m_spareLevelStorageCount] = _pData;
+	m_spareLevelStorageSize[m_spareLevelStorageCount] = _byteSize;
+	++m_spareLevelStorageCount;
+}
+
+uint8_t* SlimKTX2::takeSpareLevelStorage(size_t _byteSize)
+{
+	// smallest spare that fits and has the current mip alignment
+	uint32_t best = MaxSpareLevelStorage;
+
+	for (uint32_t i = 0u; i < m_spareLevelStorageCount; ++i)
+	{
+		if (m_spareLevelStorageSize[i] >= _byteSize && reinterpret_cast<uintptr_t>(m_pSpareLevelStorage[i]) % m_mipAlignment == 0u &&
+			(best == MaxSpareLevelStorage || m_spareLevelStorageSize[i] < m_spareLevelStorageSize[best]))
+		{
+			best = i;
+		}
+	}
+
+	if (best == MaxSpareLevelStorage)
+	{
+		return nullptr;
+	}
+
+	uint8_t* pData = m_pSpareLevelStorage[best];
+
+	--m_spareLevelStorageCount;
+	m_pSpareLevelStorage[best] = m_pSpareLevelStorage[m_spareLevelStorageCount];
+	m_spareLevelStorageSize[best] = m_spareLevelStorageSize[m_spareLevelStorageCount];
+
+	return pData;
+}
+
+LevelIndex* SlimKTX2::allocateLevelIndex(uint32_t _levelCount)
+{
+	if (m_pSpareLevels != nullptr && _levelCount <= m_spareLevelCapacity)
+	{
+		LevelIndex* pLevels = m_pSpareLevels;
+		m_pSpareLevels = nullptr;
+		m_spareLevelCapacity = 0u;
+
+		return pLevels;
+	}
+
+	return allocateArray<LevelIndex>(_levelCount);
 }
 
 uint64_t SlimKTX2::getFaceImageOffset(uint32_t _level, uint32_t _face, uint32_t _layer) const
@@ -69,412 +350,1798 @@ uint64_t SlimKTX2::getFaceImageOffset(uint32_t _level, uint32_t _face, uint32_t
 
 Result SlimKTX2::parse(IOHandle _file, TranscodeFormat _targetFormat)
 {
-	clear();
+	ParseOptions options{};
+	options.targetFormat = _targetFormat;
 
-	Result res = Result::Success;
+	return parse(_file, options);
+}
 
-	if (read(_file, &m_header) == false)
+Result SlimKTX2::parse(IOHandle _file, const ParseOptions& _options)
+{
+	Result res = parseHeader(_file, _options);
+	if (res != Result::Success)
 	{
-		return Result::IOReadFail;
+		return res;
 	}
 
-	if (memcmp(m_header.identifier, Header::Magic, sizeof(m_header.identifier)) != 0)
+	res = loadLevels(0u, getLevelCount() - 1u);
+
+	// all levels are resident, neither the file nor the transcoder are required anymore
+	m_file = nullptr;
+	destroyTranscoder();
+
+	return res;
+}
+
+Result SlimKTX2::parseMultiTarget(IOHandle _file, const TranscodeFormat* _pTargetFormats, uint32_t _targetCount, SlimKTX2* _pOutImages, uint32_t _transcodeFlags)
+{
+	reset();
+
+	if (_pTargetFormats == nullptr || _pOutImages == nullptr)
 	{
-		return Result::InvalidIdentifier;
+		return Result::UnknownFormat;
 	}
 
-	if (read(_file, &m_sections) == false)
+	Result res = parseMetadata(_file);
+	if (res != Result::Success)
 	{
-		return Result::IOReadFail;
+		return res;
+	}
+
+	if (m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::BasisLZ))
+	{
+		log("transcode targets require BasisLZ supercompression\n");
+		return Result::UnknownFormat;
 	}
 
+#ifdef SLIMKTX2_USE_BASISU
 	const uint32_t levelCount = getLevelCount();
 
-	m_pLevels = allocateArray<LevelIndex>(levelCount);
+	// header, indices, dfd, kvd and sgd are read once and parsed by every output from memory
+	const uint64_t indexSize = sizeof(Header) + sizeof(SectionIndex) + sizeof(LevelIndex) * static_cast<uint64_t>(levelCount);
 
-	if (read(_file, m_pLevels, levelCount) == false)
+	uint64_t metadataEnd = indexSize;
+	if (m_sections.dfdByteLength != 0u)
 	{
-		return Result::IOReadFail;
+		metadataEnd = max<uint64_t>(metadataEnd, static_cast<uint64_t>(m_sections.dfdByteOffset) + m_sections.dfdByteLength);
 	}
-
-	// dfd is mandatory
-	if (seek(_file, m_sections.dfdByteOffset) == false)
+	if (m_sections.kvdByteLength != 0u)
 	{
-		return Result::IOReadFail;
+		metadataEnd = max<uint64_t>(metadataEnd, static_cast<uint64_t>(m_sections.kvdByteOffset) + m_sections.kvdByteLength);
 	}
-
-	if (readDFD(_file) == false)
+	if (m_sections.sgdByteLength != 0u)
 	{
-		return Result::IOReadFail;
+		metadataEnd = max<uint64_t>(metadataEnd, m_sections.sgdByteOffset + m_sections.sgdByteLength);
 	}
 
-	// kvd is mandatory
-	if (seek(_file, m_sections.kvdByteOffset) == false)
+	uint64_t levelDataStart = UINT64_MAX;
+	for (uint32_t level = 0u; level < levelCount; ++level)
 	{
-		return Result::IOReadFail;
+		if (m_pLevels[level].byteLength != 0u)
+		{
+			levelDataStart = min(levelDataStart, m_pLevels[level].byteOffset);
+		}
 	}
 
-	if (readKVD(_file) == false)
+	// sections packed in front of the level data (only alignment padding in between) are read in one go. otherwise (corrupt offsets,
+	// unusual layouts) the sections are read one by one into a compact copy with patched offsets, so the allocation never exceeds
+	// the section lengths plus the padding slack
+	const uint64_t sectionsSize = indexSize + m_sections.dfdByteLength + m_sections.kvdByteLength + m_sections.sgdByteLength;
+	const uint64_t paddingSlack = 16u;
+	const bool contiguous = levelDataStart != UINT64_MAX && metadataEnd <= levelDataStart && metadataEnd <= sectionsSize + paddingSlack;
+	const uint64_t metadataSize = contiguous ? metadataEnd : sectionsSize;
+
+	uint8_t* pMetadata = allocateArray<uint8_t>(static_cast<size_t>(metadataSize));
+	uint8_t** pReadLevels = allocateArray<uint8_t*>(levelCount);
+
+	if (pMetadata == nullptr || pReadLevels == nullptr)
 	{
-		return Result::IOReadFail;
+		if (pMetadata != nullptr)
+		{
+			free(pMetadata);
+		}
+		if (pReadLevels != nullptr)
+		{
+			free(pReadLevels);
+		}
+		return Result::MipLevelArryNotAllocated;
 	}
+	memset(pReadLevels, 0, sizeof(uint8_t*) * levelCount);
 
-	// TODO: sgd - basisLZ only atm
-	if (m_sections.sgdByteLength != 0u)
+	if (contiguous)
 	{
-		if (seek(_file, m_sections.sgdByteOffset) == false)
+		if (readAt(_file, 0u, pMetadata, static_cast<size_t>(metadataSize)) == false)
 		{
-			return Result::IOReadFail;
+			res = Result::IOReadFail;
 		}
+	}
+	else
+	{
+		SectionIndex sections = m_sections;
+		uint64_t offset = indexSize;
 
-		res = readSGD(_file);
-		if (res != Result::Success)
+		bool success = readAt(_file, 0u, pMetadata, static_cast<size_t>(indexSize));
+
+		// appends a section to the copy, empty sections are not read (their offset may be anything)
+		auto readSection = [&](uint64_t _offset, uint64_t _length) -> uint64_t
 		{
-			return res;
+			const uint64_t sectionOffset = offset;
+			if (_length != 0u)
+			{
+				success = success && readAt(_file, static_cast<size_t>(_offset), pMetadata + offset, static_cast<size_t>(_length));
+				offset += _length;
+			}
+			return sectionOffset;
+		};
+
+		sections.dfdByteOffset = static_cast<uint32_t>(readSection(m_sections.dfdByteOffset, m_sections.dfdByteLength));
+		sections.kvdByteOffset = static_cast<uint32_t>(readSection(m_sections.kvdByteOffset, m_sections.kvdByteLength));
+		sections.sgdByteOffset = readSection(m_sections.sgdByteOffset, m_sections.sgdByteLength);
+
+		memcpy(pMetadata + sizeof(Header), &sections, sizeof(SectionIndex));
+
+		if (success == false)
+		{
+			res = Result::IOReadFail;
 		}
 	}
 
-	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ))
+	// compressed levels are read once for all targets
+	for (uint32_t level = 0u; level < levelCount && res == Result::Success; ++level)
 	{
-#ifdef SLIMKTX2_USE_BASISU
-		BasisTranscoder bit;
-		if (bit.decompress(*this, _file, _targetFormat) == false)
+		pReadLevels[level] = allocateArray<uint8_t>(static_cast<size_t>(max<uint64_t>(m_pLevels[level].byteLength, 1u)));
+		if (pReadLevels[level] == nullptr)
 		{
-			return Result::BasisTranscodeFailed;
+			res = Result::MipLevelArryNotAllocated;
 		}
-#else
-		log("slimktx2 not compiled with basisu support\n");
-		return Result::UnknownFormat;
-#endif
 	}
-	else if (m_header.vkFormat != Format::UNDEFINED)
+
+	if (res == Result::Success)
 	{
-		res = allocateMipLevelArray();
-		if (res != Result::Success)
+		m_file = _file;
+		res = readLevels(pReadLevels, 0u, levelCount - 1u);
+		m_file = nullptr;
+	}
+
+	// all outputs share the decoded etc1s codebook
+	TranscoderContext localContext(m_callbacks, 1u);
+	TranscoderContext* pContext = m_pTranscoderContext != nullptr ? m_pTranscoderContext : &localContext;
+
+	for (uint32_t target = 0u; target < _targetCount && res == Result::Success; ++target)
+	{
+		SlimKTX2& out = _pOutImages[target];
+		out.reset();
+
+		DefaultMemoryStream stream(pMetadata, static_cast<size_t>(metadataSize));
+		const Callbacks outCallbacks = out.m_callbacks;
+		out.m_callbacks = DefaultMemoryStreamCallback().getCallback() | outCallbacks;
+
+		res = out.parseMetadata(&stream);
+
+		out.m_callbacks = outCallbacks;
+
+		// the compact copy has its own section offsets, report those of the file
+		out.m_sections = m_sections;
+
+		if (res == Result::Success)
 		{
-			return res;
+			out.m_pTranscoder = out.allocateArray<BasisTranscoder>();
+			if (out.m_pTranscoder == nullptr || out.m_pTranscoder->init(out, _pTargetFormats[target], _transcodeFlags, pContext) == false)
+			{
+				res = Result::BasisTranscodeFailed;
+			}
 		}
 
-		for (uint32_t level = levelCount - 1u; level <= levelCount; --level)
+		if (res == Result::Success)
 		{
-			const LevelIndex& lvl = m_pLevels[level];
+			res = out.allocateMipLevelPointers();
+		}
 
-			// skip to first level
-			if (seek(_file, lvl.byteOffset) == false)
-			{
-				return Result::IOReadFail;
-			}
+		for (uint32_t level = 0u; level < levelCount && res == Result::Success; ++level)
+		{
+			res = out.allocateMipLevel(level);
+		}
 
-			if (read(_file, m_pMipLevelArray[level], lvl.byteLength) == false)
-			{
-				return Result::IOReadFail;
-			}
+		if (res == Result::Success)
+		{
+			res = out.decompressLevels(pReadLevels, 0u, levelCount - 1u);
 		}
+
+		// release the codebook before a local context goes out of scope
+		out.destroyTranscoder();
 	}
-	else
+
+	for (uint32_t level = 0u; level < levelCount; ++level)
 	{
-		log("vkFormat not specified\n");
-		return Result::UnknownFormat;
+		if (pReadLevels[level] != nullptr)
+		{
+			free(pReadLevels[level]);
+		}
 	}
+	free(pReadLevels);
+	free(pMetadata);
 
-	return Result::Success;
+	return res;
+#else
+	(void)_targetCount;
+	(void)_transcodeFlags;
+
+	log("slimktx2 not compiled with basisu support\n");
+	return Result::UnknownFormat;
+#endif
 }
 
-Result SlimKTX2::serialize(IOHandle _file)
+Result SlimKTX2::parseBatch(const IOHandle* _pFiles, uint32_t _count, SlimKTX2* _pOutImages, Result* _pResults, const ParseOptions& _options)
 {
-	if (m_pLevels == nullptr)
+	if (_pFiles == nullptr || _pOutImages == nullptr)
 	{
-		log("LevelIndex not specified\n");
-		return Result::LevelIndexNotAllocated;
+		return Result::UnknownFormat;
 	}
 
-	if (m_pMipLevelArray == nullptr)
+	struct BatchTask
 	{
-		log("MipLevelArray not specified\n");
-		return Result::MipLevelArryNotAllocated;
-	}
+		const IOHandle* pFiles;
+		SlimKTX2* pOutImages;
+		Result* pResults;
+		const ParseOptions* pOptions;
+		TranscoderContext* pContext;
+		std::atomic<uint64_t> firstFailed; // file index in the upper, Result in the lower 32 bits
+	};
 
-	if (m_dfd.pBlocks == nullptr)
+	BatchTask task{};
+	task.pFiles = _pFiles;
+	task.pOutImages = _pOutImages;
+	task.pResults = _pResults;
+	task.pOptions = &_options;
+	task.pContext = m_pTranscoderContext;
+	task.firstFailed = UINT64_MAX;
+
+#ifdef SLIMKTX2_USE_BASISU
+	// files sharing ETC1S codebooks decode them once per batch
+	TranscoderContext localContext(m_callbacks);
+	if (task.pContext == nullptr)
 	{
-		log("DFD not specified\n");
-		return Result::DataFormatDescNotAllocated;
+		task.pContext = &localContext;
 	}
+#endif
 
-	if (m_kvd.pKeyValues == nullptr)
+	parallelFor(_count, [](void* _pTaskData, uint32_t _index)
 	{
-		log("KVD not specified\n");
-		return Result::KeyValueDataNotAllocated;
-	}
+		BatchTask& task = *static_cast<BatchTask*>(_pTaskData);
+		SlimKTX2& out = task.pOutImages[_index];
 
-	const bool isBasis = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ);
+		TranscoderContext* pOutContext = out.m_pTranscoderContext;
+		if (pOutContext == nullptr)
+		{
+			out.m_pTranscoderContext = task.pContext;
+		}
 
-	if (m_basisLZ.pImageDescs == nullptr && isBasis)
-	{
-		log("SGD not specified\n");
-		return Result::SupercompressionGlobalDataNotAllocated;
-	}
+		const Result res = out.parse(task.pFiles[_index], *task.pOptions);
 
-	const size_t streamStart = tell(_file);
-	auto filePos = [&](IOHandle file) -> size_t { return tell(file) - streamStart; };
+		// release the codebook before a local context goes out of scope
+		out.destroyTranscoder();
+		out.m_pTranscoderContext = pOutContext;
 
-	const uint32_t levelCount = getLevelCount();
+		if (task.pResults != nullptr)
+		{
+			task.pResults[_index] = res;
+		}
 
-	const uint32_t dfdByteLength = m_dfd.computeSize();
-	const uint32_t dfdByteOffset = sizeof(Header) + sizeof(SectionIndex) + sizeof(LevelIndex) * m_header.levelCount;
-	const uint32_t kvdByteLength = m_kvd.computeSize();
-	const uint32_t kvdByteOffset = dfdByteOffset + dfdByteLength;
-	const uint64_t sgdByteLength = 0u;
-	uint64_t sgdByteOffset = static_cast<uint64_t>(kvdByteOffset) + static_cast<uint64_t>(kvdByteLength);
-	
-	if (m_dfd.totalSize == 0)
+		if (res != Result::Success)
+		{
+			const uint64_t failed = (static_cast<uint64_t>(_index) << 32u) | static_cast<uint32_t>(res);
+			uint64_t firstFailed = task.firstFailed.load();
+			while (failed < firstFailed && task.firstFailed.compare_exchange_weak(firstFailed, failed) == false) {}
+		}
+	}, &task);
+
+	const uint64_t firstFailed = task.firstFailed.load();
+
+	return firstFailed == UINT64_MAX ? Result::Success : static_cast<Result>(static_cast<uint32_t>(firstFailed));
+}
+
+Result SlimKTX2::inspect(IOHandle _file, InspectInfo& _info, void* _pStorage, size_t _storageSize)
+{
+	_info = InspectInfo{};
+
+	if (readAt(_file, 0u, &_info.header) == false)
 	{
-		m_dfd.totalSize = dfdByteLength;
+		return Result::IOReadFail;
 	}
 
-	const uint32_t sdgPadding = getPadding(sgdByteOffset, 8u);
+	if (memcmp(_info.header.identifier, Header::Magic, sizeof(_info.header.identifier)) != 0)
+	{
+		return Result::InvalidIdentifier;
+	}
 
-	if (sgdByteLength > 0u)
+	if (readAt(_file, sizeof(Header), &_info.sections) == false)
 	{
-		sgdByteOffset += sdgPadding;
+		return Result::IOReadFail;
 	}
 
-	uint64_t levelOffset = sgdByteOffset + sgdByteLength;
+	const uint32_t levelCount = _info.getLevelCount();
+	const uint64_t levelIndexSize = sizeof(LevelIndex) * static_cast<uint64_t>(levelCount);
+	const uint64_t requiredSize = levelIndexSize + _info.sections.dfdByteLength + _info.sections.kvdByteLength;
 
-	for (uint32_t level = levelCount - 1u; level <= levelCount; --level)
+	_info.requiredStorageSize = static_cast<size_t>(min<uint64_t>(requiredSize, SIZE_MAX));
+
+	if (_pStorage == nullptr || _storageSize < requiredSize)
 	{
-		const uint32_t mipPad = getMipPadding(levelOffset, m_header.vkFormat, m_header.supercompressionScheme != 0u);
-		levelOffset += mipPad;
+		return Result::StorageTooSmall;
+	}
 
-		// start with the small level, fill them in reverse
-		uint64_t levelSize = getFaceSize(m_header.vkFormat, level, m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
-		levelSize *= getFaceCount();
-		levelSize *= getLayerCount();
+	// level index entries are 8 byte aligned, the dfd follows at a multiple of 24 bytes
+	uint8_t* pStorage = static_cast<uint8_t*>(_pStorage);
 
-		// absolute levelOffset within the file
-		m_pLevels[level].byteOffset = levelOffset;
-		m_pLevels[level].byteLength = levelSize;
-		m_pLevels[level].uncompressedByteLength = isBasis ? 0u : levelSize; // uncompressedByteLength % (faceCount * max(1, layerCount)) == 0
+	LevelIndex* pLevels = reinterpret_cast<LevelIndex*>(pStorage);
+	if (readAt(_file, sizeof(Header) + sizeof(SectionIndex), pLevels, levelCount) == false)
+	{
+		return Result::IOReadFail;
+	}
+	_info.pLevels = pLevels;
+	pStorage += levelIndexSize;
 
-		levelOffset += levelSize;
+	// dfd is mandatory
+	_info.dfd.pData = pStorage;
+	if (readAt(_file, _info.sections.dfdByteOffset, pStorage, _info.sections.dfdByteLength) == false || _info.dfd.validate(_info.sections.dfdByteLength) == false)
+	{
+		log("Invalid DFD\n");
+		_info.dfd = DataFormatDesc{};
+		return Result::IOReadFail;
 	}
+	pStorage += _info.sections.dfdByteLength;
 
-	write(_file, &m_header);
+	if (_info.sections.kvdByteLength != 0u)
+	{
+		if (readAt(_file, _info.sections.kvdByteOffset, pStorage, _info.sections.kvdByteLength) == false)
+		{
+			return Result::IOReadFail;
+		}
+		_info.pKVD = pStorage;
+	}
 
-	m_sections.dfdByteLength = dfdByteLength;
-	m_sections.dfdByteOffset = dfdByteOffset;
+	return Result::Success;
+}
 
-	m_sections.kvdByteLength = kvdByteLength;
-	m_sections.kvdByteOffset = kvdByteOffset;
+Result SlimKTX2::parseHeader(IOHandle _file, TranscodeFormat _targetFormat)
+{
+	ParseOptions options{};
+	options.targetFormat = _targetFormat;
 
-	//sdg is optional
-	m_sections.sgdByteLength = sgdByteLength;
-	m_sections.sgdByteOffset = sgdByteLength != 0u ? sgdByteOffset : 0u;
+	return parseHeader(_file, options);
+}
 
-	size_t curPos = filePos(_file);
-	log("SectionIndex offset %llu size %llu\n", curPos, sizeof(SectionIndex));
-	write(_file, &m_sections);
+Result SlimKTX2::parseHeader(IOHandle _file, const ParseOptions& _options)
+{
+	reset();
 
-	curPos = filePos(_file);
-	log("LevelIndex offset %llu size %llu\n", curPos, sizeof(LevelIndex) * m_header.levelCount);
-	write(_file, m_pLevels, m_header.levelCount);
+	Result res = parseMetadata(_file);
+	if (res != Result::Success)
+	{
+		return res;
+	}
 
-	curPos = filePos(_file);
-	log("DFD offset %llu size %u\n", curPos, dfdByteLength);
+	skipLevels(_options);
 
-	if (dfdByteLength != 0u)
+	// UASTC is stored without supercompression or zstd compressed and transcoded after reading / decompressing
+	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ) || isUASTC())
 	{
-		if (curPos != m_sections.dfdByteOffset)
+#ifdef SLIMKTX2_USE_BASISU
+		m_pTranscoder = allocateArray<BasisTranscoder>();
+		if (m_pTranscoder == nullptr || m_pTranscoder->init(*this, _options.targetFormat, _options.transcodeFlags, m_pTranscoderContext) == false)
 		{
-			return Result::IOWriteFail;
+			return Result::BasisTranscodeFailed;
 		}
+#else
+		log("slimktx2 not compiled with basisu support\n");
+		return Result::UnknownFormat;
+#endif
+	}
+	else if (m_header.vkFormat == Format::UNDEFINED)
+	{
+		log("vkFormat not specified\n");
+		return Result::UnknownFormat;
+	}
 
-		writeDFD(_file);	
+	res = allocateMipLevelPointers();
+	if (res != Result::Success)
+	{
+		return res;
 	}
 
-	curPos = filePos(_file);
-	log("KVD offset %llu size %u\n", curPos, kvdByteLength);
+	m_file = _file;
 
-	if (kvdByteLength != 0u)
+	return Result::Success;
+}
+
+Result SlimKTX2::loadLevel(uint32_t _level)
+{
+	return loadLevels(_level, _level);
+}
+
+Result SlimKTX2::loadLevels(uint32_t _firstLevel, uint32_t _lastLevel)
+{
+	if (m_pMipLevelArray == nullptr)
 	{
-		if (curPos != m_sections.kvdByteOffset)
+		return Result::MipLevelArryNotAllocated;
+	}
+
+	if (_firstLevel > _lastLevel || _lastLevel >= getLevelCount())
+	{
+		return Result::InvalidLevelIndex;
+	}
+
+	const uint32_t levelCount = getLevelCount();
+
+	// supercompressed and UASTC levels are read to separate buffers and decoded to the mip level array
+	const bool isEncoded = m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::None) || m_pTranscoder != nullptr;
+
+	// BasisLZ levels that are not addressable in memory are streamed image by image instead of reading whole compressed levels
+	const bool streamImages = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ) && m_pSourceData == nullptr;
+
+	// levels loaded by this call
+	bool* pNewLevels = allocateArray<bool>(levelCount);
+
+	// destinations of the file reads, supercompressed levels are decompressed to the mip level array afterwards.
+	// for addressable files they point to the compressed data in m_pSourceData
+	uint8_t** pReadLevels = allocateArray<uint8_t*>(levelCount);
+
+	if (pNewLevels == nullptr || pReadLevels == nullptr)
+	{
+		if (pNewLevels != nullptr)
 		{
-			return Result::IOWriteFail;
+			free(pNewLevels);
 		}
-
-		writeKVD(_file);
+		if (pReadLevels != nullptr)
+		{
+			free(pReadLevels);
+		}
+		return Result::MipLevelArryNotAllocated;
 	}
+	memset(pNewLevels, 0, sizeof(bool) * levelCount);
+	memset(pReadLevels, 0, sizeof(uint8_t*) * levelCount);
 
-	// dfd and kvd are required fields and the validator will emit warnings
-	// some parser implementation still work as they also ignore those fields.
+	Result res = Result::Success;
 
-	// after kvd, before sdg
-	if (m_sections.sgdByteLength > 0u)
+	// allocate up front, the allocation callbacks are not required to be thread safe
+	for (uint32_t level = _firstLevel; level <= _lastLevel && res == Result::Success; ++level)
 	{
-		writePadding(_file, sdgPadding);
+		if (m_pMipLevelArray[level] != nullptr)
+		{
+			continue; // already loaded
+		}
+
+		if (m_file == nullptr && m_pSourceData == nullptr)
+		{
+			log("level %u can not be loaded, no file specified\n", level);
+			res = Result::IOReadFail;
+			break;
+		}
+
+		res = allocateMipLevel(level);
+		if (res != Result::Success)
+		{
+			break;
+		}
+
+		pNewLevels[level] = true;
+
+		if (streamImages == false)
+		{
+			res = allocateLevelReadBuffer(level, pReadLevels[level]);
+		}
 	}
 
-	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ))
+	if (res == Result::Success && streamImages)
 	{
-		curPos = filePos(_file);
-		log("SGD offset %llu size %u\n", curPos, sgdByteLength);
+		res = streamLevels(pNewLevels, _firstLevel, _lastLevel);
+	}
+	else if (res == Result::Success)
+	{
+		if (m_pSourceData == nullptr)
+		{
+			res = readLevels(pReadLevels, _firstLevel, _lastLevel);
+		}
 
-		if (curPos != m_sections.sgdByteOffset)
+		if (res == Result::Success && isEncoded)
 		{
-			return Result::IOWriteFail;
+			res = decompressLevels(pReadLevels, _firstLevel, _lastLevel);
 		}
+	}
 
-		writeSGD(_file);
+	for (uint32_t level = _firstLevel; level <= _lastLevel; ++level)
+	{
+		if (pNewLevels[level])
+		{
+			if (isEncoded && m_pSourceData == nullptr && pReadLevels[level] != nullptr)
+			{
+				free(pReadLevels[level]);
+			}
+
+			// keep the level unloaded so it can be requested again
+			if (res != Result::Success)
+			{
+				unloadLevel(level);
+			}
+		}
 	}
 
-	for (uint32_t level = levelCount - 1u; level <= levelCount; --level)
+	free(pReadLevels);
+	free(pNewLevels);
+
+	return res;
+}
+
+bool SlimKTX2::isLevelLoaded(uint32_t _level) const
+{
+	return m_pMipLevelArray != nullptr && _level < getLevelCount() && m_pMipLevelArray[_level] != nullptr;
+}
+
+Result SlimKTX2::transcodeRegion(uint32_t _level, uint32_t _face, uint32_t _layer, uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height, void* _pDst, uint64_t _dstRowPitch)
+{
+	if (m_pLevels == nullptr)
 	{
-		const LevelIndex& lvl = m_pLevels[level];
+		return Result::LevelIndexNotAllocated;
+	}
+	if (_level >= m_header.levelCount)
+	{
+		return Result::InvalidLevelIndex;
+	}
+	if (_face >= m_header.faceCount)
+	{
+		return Result::InvalidFaceIndex;
+	}
+	if (_layer >= getLayerCount())
+	{
+		return Result::InvalidLayerIndex;
+	}
 
-		curPos = filePos(_file);
+	const bool basisLZ = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ);
+	const bool uastc = isUASTC();
 
-		const uint32_t mipPad = getMipPadding(curPos, m_header.vkFormat, m_header.supercompressionScheme != 0u);
+	// BasisLZ and UASTC regions are aligned to the 4x4 blocks of the source
+	uint32_t blockWidth = 4u;
+	uint32_t blockHeight = 4u;
+	if (basisLZ == false && uastc == false)
+	{
+		getBlockSize(m_header.vkFormat, blockWidth, blockHeight);
+	}
 
-		writePadding(_file, mipPad);
+	const uint32_t levelWidth = max(1u, m_header.pixelWidth >> _level);
+	const uint32_t levelHeight = max(1u, m_header.pixelHeight >> _level);
 
-		curPos = filePos(_file);
+	if (_pDst == nullptr || m_header.pixelDepth > 1u || _width == 0u || _height == 0u ||
+		_x % blockWidth != 0u || _y % blockHeight != 0u ||
+		static_cast<uint64_t>(_x) + _width > levelWidth || static_cast<uint64_t>(_y) + _height > levelHeight ||
+		(_width % blockWidth != 0u && _x + _width != levelWidth) || (_height % blockHeight != 0u && _y + _height != levelHeight))
+	{
+		return Result::InvalidRegion;
+	}
 
-		log("level %u offset %llu length %llu padding %u\n", level, lvl.byteOffset, lvl.byteLength, mipPad);
+	const uint64_t rowPitch = getRowPitch(m_header.vkFormat, _width);
+	if (_dstRowPitch == 0u)
+	{
+		_dstRowPitch = rowPitch;
+	}
+	else if (_dstRowPitch < rowPitch)
+	{
+		return Result::InvalidRegion;
+	}
 
-		// skip to first level
-		if (lvl.byteOffset != curPos)
+	// uncompressed UASTC blocks are addressable in the file like BasisLZ slices, zstd compressed UASTC levels are decompressed and loaded as a whole
+	const bool direct = basisLZ || (uastc && m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::None));
+
+	if (direct && isLevelLoaded(_level) == false)
+	{
+#ifdef SLIMKTX2_USE_BASISU
+		if (m_pTranscoder == nullptr || m_file == nullptr ||
+			m_pTranscoder->transcodeRegion(*this, _level, _face, _layer, _x, _y, _width, _height, static_cast<uint8_t*>(_pDst), _dstRowPitch) == false)
 		{
-			return Result::IOWriteFail;
+			return Result::BasisTranscodeFailed;
 		}
 
-		write(_file, m_pMipLevelArray[level], lvl.byteLength);
+		return Result::Success;
+#else
+		log("slimktx2 not compiled with basisu support\n");
+		return Result::UnknownFormat;
+#endif
 	}
 
-	curPos = filePos(_file);
-	log("Total file size %llu\n", curPos);
+	if (isLevelLoaded(_level) == false)
+	{
+		const Result res = loadLevel(_level);
+		if (res != Result::Success)
+		{
+			return res;
+		}
+	}
 
-	if (levelOffset != curPos)
+	uint8_t* pImage = nullptr;
+	const Result res = getImage(pImage, _level, _face, _layer);
+	if (res != Result::Success)
 	{
-		return Result::IOWriteFail;
+		return res;
 	}
 
+	copyRegion(m_header.vkFormat, pImage, levelWidth, _x, _y, _width, _height, static_cast<uint8_t*>(_pDst), _dstRowPitch);
+
 	return Result::Success;
 }
 
-uint32_t SlimKTX2::getLevelCount() const
+Result SlimKTX2::parseMapped(const uint8_t* _pData, size_t _byteSize, TranscodeFormat _targetFormat)
 {
-	return m_header.levelCount != 0u ? m_header.levelCount : 1u;
+	ParseOptions options{};
+	options.targetFormat = _targetFormat;
+
+	return parseMapped(_pData, _byteSize, options);
 }
 
-uint32_t SlimKTX2::getLayerCount() const
+Result SlimKTX2::parseMapped(const uint8_t* _pData, size_t _byteSize, const ParseOptions& _options)
 {
-	return m_header.layerCount != 0u ? m_header.layerCount : 1u;
-}
+	reset();
+
+	if (_pData == nullptr)
+	{
+		return Result::IOReadFail;
+	}
+
+	// route all section reads through a memory stream on top of the mapping, allocation and logging stay with the user callbacks
+	DefaultMemoryStream stream(_pData, _byteSize);
+	const Callbacks userCallbacks = m_callbacks;
+	m_callbacks = DefaultMemoryStreamCallback().getCallback() | userCallbacks;
+
+	Result res = parseMetadata(&stream);
+
+	if (res == Result::Success && (m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::None) || m_header.vkFormat == Format::UNDEFINED))
+	{
+		// supercompressed data needs to be decoded to its own storage, but is decoded directly from the mapping
+		res = parseHeader(&stream, _options);
+		m_callbacks = userCallbacks;
+
+		if (res == Result::Success)
+		{
+			m_file = nullptr;
+			m_pSourceData = _pData;
+			m_sourceByteSize = _byteSize;
+
+			res = loadLevels(0u, getLevelCount() - 1u);
+		}
+
+		m_pSourceData = nullptr;
+		m_sourceByteSize = 0u;
+		destroyTranscoder();
+
+		return res;
+	}
+
+	m_callbacks = userCallbacks;
+
+	if (res != Result::Success)
+	{
+		return res;
+	}
+
+	skipLevels(_options);
+
+	const uint32_t levelCount = getLevelCount();
+
+	// only the pointer array is allocated, levels point into the mapping
+	res = allocateMipLevelPointers(false);
+	if (res != Result::Success)
+	{
+		return res;
+	}
+
+	m_pMappedData = _pData;
+
+	for (uint32_t level = 0u; level < levelCount; ++level)
+	{
+		const LevelIndex& lvl = m_pLevels[level];
+
+		if (lvl.byteLength < getLevelSize(level) || lvl.byteOffset > _byteSize || lvl.byteLength > _byteSize - lvl.byteOffset)
+		{
+			return Result::IOReadFail;
+		}
+
+		m_pMipLevelArray[level] = const_cast<uint8_t*>(_pData + lvl.byteOffset);
+	}
+
+	return Result::Success;
+}
+
+void SlimKTX2::skipLevels(const ParseOptions& _options)
+{
+	const uint32_t levelCount = getLevelCount();
+
+	uint32_t skip = min(_options.firstLevel, levelCount - 1u);
+
+	if (_options.maxResolution != 0u)
+	{
+		while (skip + 1u < levelCount && max(m_header.pixelWidth >> skip, m_header.pixelHeight >> skip, m_header.pixelDepth >> skip) > _options.maxResolution)
+		{
+			++skip;
+		}
+	}
+
+	if (skip == 0u)
+	{
+		return;
+	}
+
+	// level 'skip' becomes level 0, all remaining levels keep their dimensions and file offsets
+	m_header.pixelWidth = max(1u, m_header.pixelWidth >> skip);
+	m_header.pixelHeight = m_header.pixelHeight != 0u ? max(1u, m_header.pixelHeight >> skip) : 0u;
+	m_header.pixelDepth = m_header.pixelDepth != 0u ? max(1u, m_header.pixelDepth >> skip) : 0u;
+	m_header.levelCount = levelCount - skip;
+
+	memmove(m_pLevels, m_pLevels + skip, sizeof(LevelIndex) * m_header.levelCount);
+
+	if (m_basisLZ.pImageDescs != nullptr)
+	{
+		const uint32_t imagesPerLevel = getFaceCount() * getLayerCount();
+		memmove(m_basisLZ.pImageDescs, m_basisLZ.pImageDescs + skip * imagesPerLevel, sizeof(BasisLZ::ImageDesc) * imagesPerLevel * m_header.levelCount);
+	}
+}
+
+Result SlimKTX2::parseMetadata(IOHandle _file)
+{
+	Result res = Result::Success;
+
+	size_t offset = 0u;
+
+	if (readAt(_file, offset, &m_header) == false)
+	{
+		return Result::IOReadFail;
+	}
+	offset += sizeof(Header);
+
+	if (memcmp(m_header.identifier, Header::Magic, sizeof(m_header.identifier)) != 0)
+	{
+		return Result::InvalidIdentifier;
+	}
+
+	if (readAt(_file, offset, &m_sections) == false)
+	{
+		return Result::IOReadFail;
+	}
+	offset += sizeof(SectionIndex);
+
+	const uint32_t levelCount = getLevelCount();
+
+	m_pLevels = allocateLevelIndex(levelCount);
+
+	if (readAt(_file, offset, m_pLevels, levelCount) == false)
+	{
+		return Result::IOReadFail;
+	}
+
+	// dfd is mandatory
+	if (readDFD(_file) == false)
+	{
+		return Result::IOReadFail;
+	}
+
+	// kvd is mandatory
+	if (readKVD(_file) == false)
+	{
+		return Result::IOReadFail;
+	}
+
+	// TODO: sgd - basisLZ only atm
+	if (m_sections.sgdByteLength != 0u)
+	{
+		res = readSGD(_file);
+		if (res != Result::Success)
+		{
+			return res;
+		}
+	}
+
+	return Result::Success;
+}
+
+Result SlimKTX2::validateContainer()
+{
+	// parse transcodes BasisLZ and UASTC levels, writing them under the original scheme and dfd would produce an invalid file.
+	// there is no BasisLZ / UASTC encoder
+	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ) || isUASTC())
+	{
+		log("BasisLZ and UASTC can not be serialized\n");
+		return Result::NotImplemented;
+	}
+
+	if (m_pLevels == nullptr)
+	{
+		log("LevelIndex not specified\n");
+		return Result::LevelIndexNotAllocated;
+	}
+
+	if (m_pMipLevelArray == nullptr)
+	{
+		log("MipLevelArray not specified\n");
+		return Result::MipLevelArryNotAllocated;
+	}
+
+	if (m_dfd.blockCount == 0u)
+	{
+		log("DFD not specified\n");
+		return Result::DataFormatDescNotAllocated;
+	}
+
+	if (m_kvd.pKeyValues == nullptr)
+	{
+		log("KVD not specified\n");
+		return Result::KeyValueDataNotAllocated;
+	}
+
+	return Result::Success;
+}
+
+Result SlimKTX2::serialize(IOHandle _file)
+{
+	Result res = validateContainer();
+	if (res != Result::Success)
+	{
+		return res;
+	}
+
+	if (m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::Zstandard))
+	{
+		return serializeContainer(_file, m_pMipLevelArray);
+	}
+
+#ifdef SLIMKTX2_USE_ZSTD
+	uint8_t** pCompressedLevels = nullptr;
+
+	res = compressLevels(pCompressedLevels);
+	if (res == Result::Success)
+	{
+		res = serializeContainer(_file, pCompressedLevels);
+	}
+
+	destroyLevelData(pCompressedLevels);
+
+	return res;
+#else
+	log("slimktx2 not compiled with zstd support\n");
+	return Result::UnknownFormat;
+#endif
+}
+
+Result SlimKTX2::computeLayout()
+{
+	Result res = validateContainer();
+	if (res != Result::Success)
+	{
+		return res;
+	}
+
+	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::Zstandard))
+	{
+#ifdef SLIMKTX2_USE_ZSTD
+		// the compressed level sizes are only known after compression
+		uint8_t** pCompressedLevels = nullptr;
+		res = compressLevels(pCompressedLevels);
+		destroyLevelData(pCompressedLevels);
+
+		if (res != Result::Success)
+		{
+			return res;
+		}
+#else
+		log("slimktx2 not compiled with zstd support\n");
+		return Result::UnknownFormat;
+#endif
+	}
+
+	layoutContainer();
+
+	return Result::Success;
+}
+
+uint64_t SlimKTX2::computeSerializedSize()
+{
+	if (computeLayout() != Result::Success)
+	{
+		return 0u;
+	}
+
+	// levels are stored from small to large, the largest level (index 0) ends the file
+	const LevelIndex& lvl = m_pLevels[0];
+	return lvl.byteOffset + lvl.byteLength;
+}
+
+const SectionIndex& SlimKTX2::getSectionIndex() const
+{
+	return m_sections;
+}
+
+const LevelIndex* SlimKTX2::getLevelIndex() const
+{
+	return m_pLevels;
+}
+
+Result SlimKTX2::serializeContainer(IOHandle _file, uint8_t* const* _pLevelData)
+{
+	// stage small writes (header, indices, dfd, kvd, sgd, padding, small levels) and flush them in large chunks
+	const bool ownsWriteBuffer = m_pUserWriteBuffer == nullptr;
+	if (ownsWriteBuffer)
+	{
+		m_pWriteBuffer = allocateArray<uint8_t>(DefaultWriteBufferSize);
+		m_writeBufferSize = m_pWriteBuffer != nullptr ? DefaultWriteBufferSize : 0u;
+	}
+	else
+	{
+		m_pWriteBuffer = m_pUserWriteBuffer;
+		m_writeBufferSize = m_userWriteBufferSize;
+	}
+	m_writeBufferOffset = 0u;
+
+	const Result res = writeContainer(_file, _pLevelData);
+
+	flushWriteBuffer(_file);
+
+	if (ownsWriteBuffer && m_pWriteBuffer != nullptr)
+	{
+		free(m_pWriteBuffer);
+	}
+	m_pWriteBuffer = nullptr;
+	m_writeBufferSize = 0u;
+
+	return res;
+}
+
+void SlimKTX2::setWriteBuffer(void* _pBuffer, size_t _byteSize)
+{
+	m_pUserWriteBuffer = static_cast<uint8_t*>(_pBuffer);
+	m_userWriteBufferSize = _pBuffer != nullptr ? _byteSize : 0u;
+}
+
+uint64_t SlimKTX2::getSGDSize() const
+{
+	// only basis lz for now
+	if (m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::BasisLZ))
+	{
+		return 0u;
+	}
+
+	const BasisLZ::Header& header = m_basisLZ.header;
+
+	return sizeof(BasisLZ::Header) + sizeof(BasisLZ::ImageDesc) * static_cast<uint64_t>(getImageCount()) +
+		static_cast<uint64_t>(header.endpointsByteLength) + header.selectorsByteLength + header.tablesByteLength + header.extendedByteLength;
+}
+
+uint64_t SlimKTX2::layoutContainer()
+{
+	const bool isBasis = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ);
+	const bool isZstd = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::Zstandard);
+
+	const uint32_t levelCount = getLevelCount();
+
+	const uint32_t dfdByteLength = m_dfd.computeSize();
+	const uint32_t dfdByteOffset = sizeof(Header) + sizeof(SectionIndex) + sizeof(LevelIndex) * m_header.levelCount;
+	const uint32_t kvdByteLength = m_kvd.computeSize();
+	const uint32_t kvdByteOffset = dfdByteOffset + dfdByteLength;
+	const uint64_t sgdByteLength = getSGDSize();
+	uint64_t sgdByteOffset = static_cast<uint64_t>(kvdByteOffset) + static_cast<uint64_t>(kvdByteLength);
+
+	if (sgdByteLength > 0u)
+	{
+		sgdByteOffset += getPadding(sgdByteOffset, 8u);
+	}
+
+	uint64_t levelOffset = sgdByteOffset + sgdByteLength;
+
+	for (uint32_t level = levelCount - 1u; level <= levelCount; --level)
+	{
+		const uint32_t mipPad = getMipPadding(levelOffset, m_header.vkFormat, m_header.supercompressionScheme != 0u);
+		levelOffset += mipPad;
+
+		// start with the small level, fill them in reverse
+		const uint64_t uncompressedSize = getLevelSize(level);
+
+		// zstd byteLength was computed by compressLevels
+		const uint64_t levelSize = isZstd ? m_pLevels[level].byteLength : uncompressedSize;
+
+		// absolute levelOffset within the file
+		m_pLevels[level].byteOffset = levelOffset;
+		m_pLevels[level].byteLength = levelSize;
+		m_pLevels[level].uncompressedByteLength = isBasis ? 0u : uncompressedSize; // uncompressedByteLength % (faceCount * max(1, layerCount)) == 0
+
+		levelOffset += levelSize;
+	}
+
+	m_sections.dfdByteLength = dfdByteLength;
+	m_sections.dfdByteOffset = dfdByteOffset;
+
+	m_sections.kvdByteLength = kvdByteLength;
+	m_sections.kvdByteOffset = kvdByteOffset;
+
+	//sdg is optional
+	m_sections.sgdByteLength = sgdByteLength;
+	m_sections.sgdByteOffset = sgdByteLength != 0u ? sgdByteOffset : 0u;
+
+	return levelOffset;
+}
+
+Result SlimKTX2::writeContainer(IOHandle _file, uint8_t* const* _pLevelData)
+{
+	const size_t streamStart = tell(_file);
+	auto filePos = [&](IOHandle file) -> size_t { return tell(file) + m_writeBufferOffset - streamStart; };
+
+	const uint32_t levelCount = getLevelCount();
+
+	// levelOffset is the final file size
+	const uint64_t levelOffset = layoutContainer();
+
+	const uint32_t dfdByteLength = m_sections.dfdByteLength;
+	const uint32_t kvdByteLength = m_sections.kvdByteLength;
+	const uint64_t sgdByteLength = m_sections.sgdByteLength;
+	const uint64_t sdgPadding = sgdByteLength != 0u ? m_sections.sgdByteOffset - (m_sections.kvdByteOffset + kvdByteLength) : 0u;
+
+	// let the stream allocate the whole file up front
+	if (m_callbacks.reserve != nullptr && m_callbacks.reserve(m_callbacks.userData, _file, streamStart + static_cast<size_t>(levelOffset)) == false)
+	{
+		log("Failed to reserve %llu bytes for serialization\n", levelOffset);
+		return Result::IOWriteFail;
+	}
+
+	write(_file, &m_header);
+
+	size_t curPos = filePos(_file);
+	log("SectionIndex offset %llu size %llu\n", curPos, sizeof(SectionIndex));
+	write(_file, &m_sections);
+
+	curPos = filePos(_file);
+	log("LevelIndex offset %llu size %llu\n", curPos, sizeof(LevelIndex) * m_header.levelCount);
+	write(_file, m_pLevels, m_header.levelCount);
+
+	curPos = filePos(_file);
+	log("DFD offset %llu size %u\n", curPos, dfdByteLength);
+
+	if (dfdByteLength != 0u)
+	{
+		if (curPos != m_sections.dfdByteOffset)
+		{
+			return Result::IOWriteFail;
+		}
+
+		writeDFD(_file);	
+	}
+
+	curPos = filePos(_file);
+	log("KVD offset %llu size %u\n", curPos, kvdByteLength);
+
+	if (kvdByteLength != 0u)
+	{
+		if (curPos != m_sections.kvdByteOffset)
+		{
+			return Result::IOWriteFail;
+		}
+
+		writeKVD(_file);
+	}
+
+	// dfd and kvd are required fields and the validator will emit warnings
+	// some parser implementation still work as they also ignore those fields.
+
+	// after kvd, before sdg
+	if (m_sections.sgdByteLength > 0u)
+	{
+		writePadding(_file, sdgPadding);
+	}
+
+	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ))
+	{
+		curPos = filePos(_file);
+		log("SGD offset %llu size %u\n", curPos, sgdByteLength);
+
+		if (curPos != m_sections.sgdByteOffset)
+		{
+			return Result::IOWriteFail;
+		}
+
+		writeSGD(_file);
+	}
+
+	// the contiguous storage holds the uncompressed levels with their padding in file order
+	bool writeStorage = m_pStorage != nullptr && _pLevelData == m_pMipLevelArray &&
+		m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::None);
+
+	for (uint32_t level = 0u; level < levelCount && writeStorage; ++level)
+	{
+		writeStorage = m_pLevels[level].byteOffset - m_pLevels[levelCount - 1u].byteOffset == getStorageOffset(level);
+	}
+
+	if (writeStorage)
+	{
+		curPos = filePos(_file);
+
+		const uint32_t mipPad = getMipPadding(curPos, m_header.vkFormat, false);
+
+		writePadding(_file, mipPad);
+
+		curPos = filePos(_file);
+
+		log("levels offset %llu length %llu padding %u\n", m_pLevels[levelCount - 1u].byteOffset, m_storageSize, mipPad);
+
+		if (m_pLevels[levelCount - 1u].byteOffset != curPos)
+		{
+			return Result::IOWriteFail;
+		}
+
+		write(_file, m_pStorage, static_cast<size_t>(m_storageSize));
+	}
+
+	for (uint32_t level = levelCount - 1u; level <= levelCount && writeStorage == false; --level)
+	{
+		const LevelIndex& lvl = m_pLevels[level];
+
+		curPos = filePos(_file);
+
+		const uint32_t mipPad = getMipPadding(curPos, m_header.vkFormat, m_header.supercompressionScheme != 0u);
+
+		writePadding(_file, mipPad);
+
+		curPos = filePos(_file);
+
+		log("level %u offset %llu length %llu padding %u\n", level, lvl.byteOffset, lvl.byteLength, mipPad);
+
+		// skip to first level
+		if (lvl.byteOffset != curPos)
+		{
+			return Result::IOWriteFail;
+		}
+
+		write(_file, _pLevelData[level], lvl.byteLength);
+	}
+
+	curPos = filePos(_file);
+	log("Total file size %llu\n", curPos);
+
+	if (levelOffset != curPos)
+	{
+		return Result::IOWriteFail;
+	}
+
+	return Result::Success;
+}
+
+uint32_t SlimKTX2::getLevelCount() const
+{
+	return m_header.levelCount != 0u ? m_header.levelCount : 1u;
+}
+
+uint32_t SlimKTX2::getLayerCount() const
+{
+	return m_header.layerCount != 0u ? m_header.layerCount : 1u;
+}
+
+uint32_t SlimKTX2::getFaceCount() const
+{
+	return m_header.faceCount != 0u ? m_header.faceCount : 1u;
+}
+
+const Header& SlimKTX2::getHeader() const
+{
+	return m_header;
+}
+
+const DataFormatDesc& SlimKTX2::getDFD() const
+{
+	return m_dfd;
+}
+
+const KeyValueData& SlimKTX2::getKVD() const
+{
+	return m_kvd;
+}
+
+Result SlimKTX2::specifyFormat(Format _vkFormat, uint32_t _width, uint32_t _height, uint32_t _levelCount, uint32_t _faceCount, uint32_t _depth, uint32_t _layerCount, SupercompressionScheme _scheme)
+{
+	if (m_pLevels != nullptr)
+	{
+		free(m_pLevels);
+	}
+
+	memcpy(m_header.identifier, Header::Magic, sizeof(m_header.identifier));
+	m_header.vkFormat = _vkFormat;
+	m_header.typeSize = getTypeSize(_vkFormat);
+	m_header.pixelWidth = _width;
+	m_header.pixelHeight = _height == 1u ? 0u : _height;
+	m_header.pixelDepth = _depth == 1u ? 0u : _depth;
+	m_header.layerCount = _layerCount;
+	m_header.faceCount = _faceCount;
+
+	uint32_t maxDim = max(_width, _height, _depth);
+	uint32_t maxLevel = 0u;
+
+	// compute maximum number of mip levels for the specified resolution
+	while (maxDim > 0u)
+	{
+		maxDim >>= 1u;
+		++maxLevel;
+	}
+
+	m_header.levelCount = min(maxLevel, _levelCount);
+	m_header.supercompressionScheme = static_cast<uint32_t>(_scheme);
+
+	const uint32_t levelCount = getLevelCount();
+	m_pLevels = allocateArray<LevelIndex>(levelCount);
+
+	addKeyValue(KeyValueData::KTXwriterKey, KeyValueData::KTXwriterKeyLength, KeyValueData::KTXwriterValue, KeyValueData::KTXwriterValueLength);
+
+	return Result::Success;
+}
+
+void ux3d::slimktx2::SlimKTX2::addDFDBlock(const DataFormatDesc::BlockHeader& _header, const DataFormatDesc::Sample* _pSamples, uint32_t _numSamples)
+{
+	DataFormatDesc::BlockHeader header = _header;
+	header.blockSize = DataFormatDesc::blockHeaderSize + _numSamples * DataFormatDesc::sampleSize;
+
+	// the new block goes to the end of the buffer, the previous blocks are copied over
+	const uint32_t offset = m_dfd.computeSize();
+	const uint32_t totalSize = offset + header.blockSize;
+
+	uint8_t* pData = allocateArray<uint8_t>(totalSize);
+
+	if (m_dfd.pData != nullptr)
+	{
+		memcpy(pData, m_dfd.pData, offset);
+		free(m_dfd.pData);
+	}
+
+	memcpy(pData, &totalSize, sizeof(uint32_t));
+	memcpy(pData + offset, &header, DataFormatDesc::blockHeaderSize);
+
+	if (_numSamples != 0u)
+	{
+		if (_pSamples != nullptr)
+		{
+			memcpy(pData + offset + DataFormatDesc::blockHeaderSize, _pSamples, _numSamples * DataFormatDesc::sampleSize);
+		}
+		else
+		{
+			memset(pData + offset + DataFormatDesc::blockHeaderSize, 0, _numSamples * DataFormatDesc::sampleSize);
+		}
+	}
+
+	m_dfd.pData = pData;
+	m_dfd.totalSize = totalSize;
+	++m_dfd.blockCount;
+}
+
+void SlimKTX2::addKeyValue(const void* _key, uint32_t _keyLength, const void* _value, uint32_t _valueLength)
+{
+	auto pEntry = allocateArray<KeyValueData::Entry>();
+	m_kvd.append(pEntry);
+
+	pEntry->keyAndValueByteLength = _keyLength + _valueLength;
+	pEntry->pKeyValue = allocateArray<uint8_t>(pEntry->keyAndValueByteLength);
+
+	memcpy(pEntry->pKeyValue, _key, _keyLength);
+	memcpy(pEntry->pKeyValue + _keyLength, _value, _valueLength);
+
+	m_kvd.addToIndex(pEntry);
+}
+
+void SlimKTX2::setContiguousStorage(bool _enable)
+{
+	m_contiguousStorage = _enable;
+}
+
+void SlimKTX2::setMipAlignment(size_t _alignment)
+{
+	m_mipAlignment = 1u;
+	while (m_mipAlignment < _alignment)
+	{
+		m_mipAlignment <<= 1u;
+	}
+}
+
+const uint8_t* SlimKTX2::getStorage() const
+{
+	return m_pStorage;
+}
+
+uint64_t SlimKTX2::getStorageSize() const
+{
+	return m_storageSize;
+}
+
+uint64_t SlimKTX2::getStorageOffset(uint32_t _level) const
+{
+	// uncompressed file layout: smallest level first, every level padded to the mip alignment of the format
+	uint64_t offset = 0u;
+
+	for (uint32_t level = getLevelCount(); level-- > _level;)
+	{
+		offset += getMipPadding(offset, m_header.vkFormat, false);
+
+		if (level == _level)
+		{
+			break;
+		}
+
+		offset += getLevelSize(level);
+	}
+
+	return offset;
+}
+
+Result SlimKTX2::allocateMipLevelArray()
+{
+	Result res = allocateMipLevelPointers();
+
+	for (uint32_t l = 0u; l < getLevelCount() && res == Result::Success; ++l)
+	{
+		res = allocateMipLevel(l);
+	}
+
+	return res;
+}
+
+Result SlimKTX2::setImage(const void* _pData, size_t _byteSize, uint32_t _level, uint32_t _face, uint32_t _layer)
+{
+	Result res = Result::Success;
+
+	if (_level >= m_header.levelCount)
+	{
+		return Result::InvalidLevelIndex;
+	}
+
+	// levels of parseMapped point into the caller's read only data
+	if (m_pMappedData != nullptr)
+	{
+		return Result::ImageNotWritable;
+	}
+
+	const uint64_t imageSize = getFaceSize(m_header.vkFormat, _level,  m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
+
+	if (_byteSize != imageSize)
+	{
+		return Result::InvalidImageSize;
+	}
+
+	uint8_t* pDst = nullptr;
+	if ((res = getImage(pDst, _level, _face, _layer, _byteSize)) != Result::Success)
+	{
+		return res;
+	}
+
+	memcpy(pDst, _pData, _byteSize);
+
+	return res;
+}
+
+Result SlimKTX2::getImage(uint8_t*& _outImageData, uint32_t _level, uint32_t _face, uint32_t _layer, uint64_t _imageSize) const
+{
+	if (m_pMipLevelArray == nullptr)
+	{
+		return Result::MipLevelArryNotAllocated;
+	}
+	if (_level >= m_header.levelCount)
+	{
+		return Result::InvalidLevelIndex;
+	}
+	if (m_pMipLevelArray[_level] == nullptr)
+	{
+		return Result::MipLevelArryNotAllocated;
+	}
+	if (_face >= m_header.faceCount)
+	{
+		return Result::InvalidFaceIndex;
+	}
+	if (_layer >= getLayerCount())
+	{
+		return Result::InvalidLayerIndex;
+	}
+
+	const uint64_t offset = getFaceImageOffset(_level, _face, _layer);
+
+	if (_imageSize != 0u) 
+	{
+		// for debugging
+		uint64_t levelSize = getFaceSize(m_header.vkFormat, _level, m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
+		levelSize *= getFaceCount();
+		levelSize *= getLayerCount();
+
+		// levelOffset / image out of container bounds
+		if (offset + _imageSize > levelSize)
+		{
+			return Result::InvalidImageSize;
+		}
+	}
+
+	_outImageData = m_pMipLevelArray[_level] + offset;
+
+	return Result::Success;
+}
+
+uint32_t SlimKTX2::getImageCount() const
+{
+	// http://github.khronos.org/KTX-Specification/#_supercompression_global_data
+
+	uint32_t layerPixelDepth = max(m_header.pixelDepth, 1u);
+	for (uint32_t i = 1; i < m_header.levelCount; ++i)
+	{
+		layerPixelDepth += max(m_header.pixelDepth >> i, 1u);
+	}
+
+	return max(m_header.layerCount, 1u) * m_header.faceCount * layerPixelDepth;
+}
+
+void* SlimKTX2::allocate(size_t _size)
+{
+	return m_callbacks.allocate(m_callbacks.userData, _size);
+}
+
+void SlimKTX2::free(void* _pData)
+{
+	m_callbacks.deallocate(m_callbacks.userData, _pData);
+}
+
+void SlimKTX2::writeBytes(IOHandle _file, const void* _pData, size_t _byteSize)
+{
+	if (m_writeBufferOffset + _byteSize > m_writeBufferSize)
+	{
+		flushWriteBuffer(_file);
+	}
+
+	if (_byteSize >= m_writeBufferSize)
+	{
+		// does not fit into the staging buffer
+		m_callbacks.write(m_callbacks.userData, _file, _pData, _byteSize);
+		return;
+	}
+
+	memcpy(m_pWriteBuffer + m_writeBufferOffset, _pData, _byteSize);
+	m_writeBufferOffset += _byteSize;
+}
+
+void SlimKTX2::flushWriteBuffer(IOHandle _file)
+{
+	if (m_writeBufferOffset != 0u)
+	{
+		m_callbacks.write(m_callbacks.userData, _file, m_pWriteBuffer, m_writeBufferOffset);
+		m_writeBufferOffset = 0u;
+	}
+}
+
+void SlimKTX2::writePadding(IOHandle _file, size_t _byteSize)
+{
+	if (m_writeBufferOffset + _byteSize <= m_writeBufferSize)
+	{
+		memset(m_pWriteBuffer + m_writeBufferOffset, 0, _byteSize);
+		m_writeBufferOffset += _byteSize;
+		return;
+	}
+
+	static const uint8_t zeros[64] = {};
+	while (_byteSize != 0u)
+	{
+		const size_t size = min(_byteSize, sizeof(zeros));
+		writeBytes(_file, zeros, size);
+		_byteSize -= size;
+	}
+}
+
+size_t SlimKTX2::tell(const IOHandle _file)
+{
+	return m_callbacks.tell(m_callbacks.userData, _file);
+}
+
+bool SlimKTX2::seek(IOHandle _file, size_t _offset)
+{
+	return m_callbacks.seek(m_callbacks.userData, _file, _offset);
+}
+
+bool SlimKTX2::readBytesAt(IOHandle _file, size_t _offset, void* _pData, size_t _size)
+{
+	if (m_callbacks.readAt != nullptr)
+	{
+		return m_callbacks.readAt(m_callbacks.userData, _file, _offset, _pData, _size) == _size;
+	}
+
+	return seek(_file, _offset) && m_callbacks.read(m_callbacks.userData, _file, _pData, _size) == _size;
+}
+
+void SlimKTX2::log(const char* _pFormat, ...)
+{
+	if (m_callbacks.log != nullptr)
+	{
+		va_list args;
+		va_start(args, _pFormat);
+		m_callbacks.log(m_callbacks.userData, _pFormat, args);
+		va_end(args);
+	}
+}
+
+uint32_t SlimKTX2::getKtxLevel(uint32_t _level) const
+{
+	return getLevelCount() - _level - 1u;
+}
+
+void SlimKTX2::destroyDFD()
+{
+	if (m_dfd.pData != nullptr)
+	{
+		free(m_dfd.pData);
+	}
+
+	m_dfd = DataFormatDesc{};
+}
+
+bool SlimKTX2::readDFD(IOHandle _file)
+{
+	destroyDFD();
+
+	// totalSize is part of the section, read it in one go
+	const uint32_t byteSize = m_sections.dfdByteLength;
+
+	if (byteSize < sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	m_dfd.pData = allocateArray<uint8_t>(byteSize);
+
+	if (readAt(_file, m_sections.dfdByteOffset, m_dfd.pData, byteSize) == false)
+	{
+		destroyDFD();
+		return false;
+	}
+
+	if (m_dfd.validate(byteSize) == false)
+	{
+		log("Invalid DFD\n");
+		destroyDFD();
+		return false;
+	}
+
+	return true;
+}
+
+void SlimKTX2::writeDFD(IOHandle _file)
+{
+	if (m_dfd.pData != nullptr)
+	{
+		write(_file, m_dfd.pData, m_dfd.totalSize);
+	}
+	else
+	{
+		const uint32_t totalSize = m_dfd.computeSize();
+		write(_file, &totalSize);
+	}
+}
+
+void SlimKTX2::destroyKVD()
+{
+	auto* pEntry = m_kvd.pKeyValues;
+	while (pEntry != nullptr)
+	{
+		auto* pNext = pEntry->pNext;
+		pEntry->pNext = nullptr;
+
+		if (pEntry->pKeyValue != nullptr)
+		{
+			free(pEntry->pKeyValue);
+			pEntry->pKeyValue = nullptr;
+		}
+
+		free(pEntry);
+		pEntry = pNext;
+	};
+	m_kvd = KeyValueData{};
+}
+
+bool SlimKTX2::readKVD(IOHandle _file)
+{
+	destroyKVD();
+
+	uint32_t remainingSize = m_sections.kvdByteLength;
+	size_t offset = m_sections.kvdByteOffset;
+
+	while (remainingSize >= sizeof(uint32_t) + 2u) // minimum entry size 
+	{
+		auto* pNew = allocateArray<KeyValueData::Entry>();
+		m_kvd.append(pNew);
+
+		if (readAt(_file, offset, &pNew->keyAndValueByteLength) == false)
+		{
+			return false;
+		}
+		offset += sizeof(uint32_t);
+
+		remainingSize -= sizeof(uint32_t);
+		remainingSize -= pNew->keyAndValueByteLength;
+
+		pNew->pKeyValue = allocateArray<uint8_t>(pNew->keyAndValueByteLength);
+		if (readAt(_file, offset, pNew->pKeyValue, pNew->keyAndValueByteLength) == false)
+		{
+			return false;
+		}
+		offset += pNew->keyAndValueByteLength;
+
+		m_kvd.addToIndex(pNew);
 
-uint32_t SlimKTX2::getFaceCount() const
-{
-	return m_header.faceCount != 0u ? m_header.faceCount : 1u;
-}
+		const uint32_t padding = getPadding(pNew->keyAndValueByteLength, 4u);
+		if (padding != 0u)
+		{
+			offset += padding;
+			remainingSize -= padding;		
+		}
+	}
 
-const Header& SlimKTX2::getHeader() const
-{
-	return m_header;
+	return remainingSize == 0u;
 }
 
-const DataFormatDesc& SlimKTX2::getDFD() const
+void SlimKTX2::writeKVD(IOHandle _file)
 {
-	return m_dfd;
+	auto* pEntry = m_kvd.pKeyValues;
+	while (pEntry != nullptr)
+	{
+		write(_file, &pEntry->keyAndValueByteLength);
+		if (pEntry->pKeyValue != nullptr && pEntry->keyAndValueByteLength > 0u)
+		{
+			write(_file, pEntry->pKeyValue, pEntry->keyAndValueByteLength);
+			const uint32_t padding = getPadding(pEntry->keyAndValueByteLength, 4u);
+			writePadding(_file, padding);
+		}
+		pEntry = pEntry->pNext;
+	};
 }
 
-const KeyValueData& SlimKTX2::getKVD() const
+void SlimKTX2::destroySGD()
 {
-	return m_kvd;
-}
+	if (m_basisLZ.pImageDescs != nullptr)
+	{
+		free(m_basisLZ.pImageDescs);
+		m_basisLZ.pImageDescs = nullptr;
+	}
 
-Result SlimKTX2::specifyFormat(Format _vkFormat, uint32_t _width, uint32_t _height, uint32_t _levelCount, uint32_t _faceCount, uint32_t _depth, uint32_t _layerCount, SupercompressionScheme _scheme)
-{
-	if (m_pLevels != nullptr)
+	if (m_basisLZ.pEndpoints != nullptr)
 	{
-		free(m_pLevels);
+		free(m_basisLZ.pEndpoints);
+		m_basisLZ.pEndpoints = nullptr;
 	}
 
-	memcpy(m_header.identifier, Header::Magic, sizeof(m_header.identifier));
-	m_header.vkFormat = _vkFormat;
-	m_header.typeSize = getTypeSize(_vkFormat);
-	m_header.pixelWidth = _width;
-	m_header.pixelHeight = _height == 1u ? 0u : _height;
-	m_header.pixelDepth = _depth == 1u ? 0u : _depth;
-	m_header.layerCount = _layerCount;
-	m_header.faceCount = _faceCount;
+	if (m_basisLZ.pSelectors != nullptr)
+	{
+		free(m_basisLZ.pSelectors);
+		m_basisLZ.pSelectors = nullptr;
+	}
 
-	uint32_t maxDim = max(_width, _height, _depth);
-	uint32_t maxLevel = 0u;
+	if (m_basisLZ.pTables != nullptr)
+	{
+		free(m_basisLZ.pTables);
+		m_basisLZ.pTables = nullptr;
+	}
 
-	// compute maximum number of mip levels for the specified resolution
-	while (maxDim > 0u)
+	if (m_basisLZ.pExtendedData != nullptr)
 	{
-		maxDim >>= 1u;
-		++maxLevel;
+		free(m_basisLZ.pExtendedData);
+		m_basisLZ.pExtendedData = nullptr;
 	}
+}
 
-	m_header.levelCount = min(maxLevel, _levelCount);
-	m_header.supercompressionScheme = static_cast<uint32_t>(_scheme);
+Result SlimKTX2::readSGD(IOHandle _file)
+{
+	// only basis lz for now
+	size_t offset = static_cast<size_t>(m_sections.sgdByteOffset);
 
-	const uint32_t levelCount = getLevelCount();
-	m_pLevels = allocateArray<LevelIndex>(levelCount);
+	if (readAt(_file, offset, &m_basisLZ.header) == false)
+	{
+		return Result::IOReadFail;
+	}
+	offset += sizeof(BasisLZ::Header);
 
-	addKeyValue(KeyValueData::KTXwriterKey, KeyValueData::KTXwriterKeyLength, KeyValueData::KTXwriterValue, KeyValueData::KTXwriterValueLength);
+	const uint32_t imageCount = getImageCount();
 
-	return Result::Success;
-}
+	m_basisLZ.pImageDescs = allocateArray<BasisLZ::ImageDesc>(imageCount);
+	if (m_basisLZ.pImageDescs == nullptr)
+	{
+		return Result::SupercompressionGlobalDataNotAllocated;
+	}
+	if (readAt(_file, offset, m_basisLZ.pImageDescs, imageCount) == false)
+	{
+		return Result::IOReadFail;
+	}
+	offset += sizeof(BasisLZ::ImageDesc) * imageCount;
 
-void ux3d::slimktx2::SlimKTX2::addDFDBlock(const DataFormatDesc::BlockHeader& _header, const DataFormatDesc::Sample* _pSamples, uint32_t _numSamples)
-{
-	auto pBlock = m_dfd.getLastBlock();
+	m_basisLZ.pEndpoints = allocateArray<uint8_t>(m_basisLZ.header.endpointsByteLength);
+	if (m_basisLZ.pEndpoints == nullptr)
+	{
+		return Result::SupercompressionGlobalDataNotAllocated;
+	}
+	if (readAt(_file, offset, m_basisLZ.pEndpoints, m_basisLZ.header.endpointsByteLength) == false)
+	{
+		return Result::IOReadFail;
+	}
+	offset += m_basisLZ.header.endpointsByteLength;
 
-	if (pBlock == nullptr) // first block
+	m_basisLZ.pSelectors = allocateArray<uint8_t>(m_basisLZ.header.selectorsByteLength);
+	if (m_basisLZ.pSelectors == nullptr)
 	{
-		pBlock = allocateArray<DataFormatDesc::Block>();
-		m_dfd.pBlocks = pBlock;
+		return Result::SupercompressionGlobalDataNotAllocated;
 	}
-	else
+	if (readAt(_file, offset, m_basisLZ.pSelectors, m_basisLZ.header.selectorsByteLength) == false)
 	{
-		pBlock->pNext = allocateArray<DataFormatDesc::Block>();
-		pBlock = pBlock->pNext;
+		return Result::IOReadFail;
 	}
+	offset += m_basisLZ.header.selectorsByteLength;
 
-	pBlock->header = _header;
-	pBlock->setSampleCount(_numSamples);
+	m_basisLZ.pTables = allocateArray<uint8_t>(m_basisLZ.header.tablesByteLength);
+	if (m_basisLZ.pTables == nullptr)
+	{
+		return Result::SupercompressionGlobalDataNotAllocated;
+	}
+	if (readAt(_file, offset, m_basisLZ.pTables, m_basisLZ.header.tablesByteLength) == false)
+	{
+		return Result::IOReadFail;
+	}
+	offset += m_basisLZ.header.tablesByteLength;
 
-	if (_pSamples != nullptr && _numSamples != 0u)
+	m_basisLZ.pExtendedData = allocateArray<uint8_t>(m_basisLZ.header.extendedByteLength);
+	if (m_basisLZ.pExtendedData == nullptr)
+	{
+		return Result::SupercompressionGlobalDataNotAllocated;
+	}
+	if (readAt(_file, offset, m_basisLZ.pExtendedData, m_basisLZ.header.extendedByteLength) == false)
 	{
-		pBlock->pSamples = allocateArray<DataFormatDesc::Sample>(_numSamples);
-		memcpy(pBlock->pSamples, _pSamples, _numSamples * sizeof(DataFormatDesc::Sample));
+		return Result::IOReadFail;
 	}
+	offset += m_basisLZ.header.extendedByteLength;
+
+	return Result::Success;
 }
 
-void SlimKTX2::addKeyValue(const void* _key, uint32_t _keyLength, const void* _value, uint32_t _valueLength)
+void SlimKTX2::writeSGD(IOHandle _file)
 {
-	auto pEntry = m_kvd.getLastEntry();
+	// only basis lz for now
+
+	write(_file, &m_basisLZ.header);
+
+	const uint32_t imageCount = getImageCount();
+
+	write(_file, m_basisLZ.pImageDescs, imageCount);
+	write(_file, m_basisLZ.pEndpoints, m_basisLZ.header.endpointsByteLength);
+	write(_file, m_basisLZ.pSelectors, m_basisLZ.header.selectorsByteLength);
+	write(_file, m_basisLZ.pTables, m_basisLZ.header.tablesByteLength);
+	write(_file, m_basisLZ.pExtendedData, m_basisLZ.header.extendedByteLength);
+}
 
-	if (pEntry == nullptr) // first entry
+void SlimKTX2::destoryMipLevelArray()
+{
+	if (m_pMipLevelArray != nullptr)
 	{
-		pEntry = allocateArray<KeyValueData::Entry>();
-		m_kvd.pKeyValues = pEntry;
+		// mapped levels are owned by the caller, stored levels are freed with the storage
+		if (m_pMappedData == nullptr && m_pStorage == nullptr)
+		{
+			for (uint32_t i = 0u; i < getLevelCount(); ++i)
+			{
+				if (m_pMipLevelArray[i] != nullptr)
+				{
+					freeLevelStorage(m_pMipLevelArray[i]);
+				}
+			}
+		}
+
+		free(m_pMipLevelArray);
+		m_pMipLevelArray = nullptr;
 	}
-	else
+
+	if (m_pStorage != nullptr)
 	{
-		pEntry->pNext = allocateArray<KeyValueData::Entry>();
-		pEntry = pEntry->pNext;
+		freeLevelStorage(m_pStorage);
+		m_pStorage = nullptr;
 	}
+	m_storageSize = 0u;
 
-	pEntry->keyAndValueByteLength = _keyLength + _valueLength;
-	pEntry->pKeyValue = allocateArray<uint8_t>(pEntry->keyAndValueByteLength);
-
-	memcpy(pEntry->pKeyValue, _key, _keyLength);
-	memcpy(pEntry->pKeyValue + _keyLength, _value, _valueLength);
+	m_pMappedData = nullptr;
 }
 
-Result SlimKTX2::allocateMipLevelArray()
+Result SlimKTX2::allocateMipLevelPointers(bool _allowStorage)
 {
 	destoryMipLevelArray();
 
@@ -485,457 +2152,554 @@ Result SlimKTX2::allocateMipLevelArray()
 		return Result::MipLevelArryNotAllocated;
 	}
 
-	m_pMipLevelArray = allocateArray<uint8_t*>(levelCount);
+	if (m_pSpareMipLevelArray != nullptr && levelCount <= m_spareMipLevelCapacity)
+	{
+		m_pMipLevelArray = m_pSpareMipLevelArray;
+		m_pSpareMipLevelArray = nullptr;
+		m_spareMipLevelCapacity = 0u;
+	}
+	else
+	{
+		m_pMipLevelArray = allocateArray<uint8_t*>(levelCount);
+	}
 
 	if (m_pMipLevelArray == nullptr)
 	{
 		return Result::MipLevelArryNotAllocated;
 	}
 
-	for (uint32_t l = 0u; l < getLevelCount(); ++l)
+	// levels are allocated on demand
+	memset(m_pMipLevelArray, 0, sizeof(uint8_t*) * levelCount);
+
+	if (m_contiguousStorage && _allowStorage)
 	{
-		uint64_t levelSize = getFaceSize(m_header.vkFormat, l, m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
-		levelSize *= getFaceCount();
-		levelSize *= getLayerCount();
+		const uint64_t storageSize = getStorageOffset(0u) + getLevelSize(0u);
 
-		if (levelSize == 0u)
+		m_pStorage = allocateLevelStorage(static_cast<size_t>(storageSize));
+		if (m_pStorage == nullptr)
 		{
 			return Result::MipLevelArryNotAllocated;
 		}
+		m_storageSize = storageSize;
 
-		m_pMipLevelArray[l] = allocateArray<uint8_t>(levelSize);
-		if (m_pMipLevelArray[l] == nullptr)
+		// the mip padding is serialized as is
+		uint64_t offset = 0u;
+		for (uint32_t level = levelCount; level-- > 0u;)
 		{
-			return Result::MipLevelArryNotAllocated;
+			const uint64_t levelOffset = getStorageOffset(level);
+			memset(m_pStorage + offset, 0, static_cast<size_t>(levelOffset - offset));
+			offset = levelOffset + getLevelSize(level);
 		}
 	}
 
 	return Result::Success;
 }
 
-Result SlimKTX2::setImage(const void* _pData, size_t _byteSize, uint32_t _level, uint32_t _face, uint32_t _layer)
+Result SlimKTX2::allocateMipLevel(uint32_t _level)
 {
-	Result res = Result::Success;
+	const uint64_t levelSize = getLevelSize(_level);
 
-	if (_level >= m_header.levelCount)
-	{
-		return Result::InvalidLevelIndex;
-	}
-
-	const uint64_t imageSize = getFaceSize(m_header.vkFormat, _level,  m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
-
-	if (_byteSize != imageSize)
+	if (levelSize == 0u)
 	{
-		return Result::InvalidImageSize;
+		return Result::MipLevelArryNotAllocated;
 	}
 
-	uint8_t* pDst = nullptr;
-	if ((res = getImage(pDst, _level, _face, _layer, _byteSize)) != Result::Success)
+	if (m_pStorage != nullptr)
 	{
-		return res;
+		m_pMipLevelArray[_level] = m_pStorage + getStorageOffset(_level);
+		return Result::Success;
 	}
 
-	memcpy(pDst, _pData, _byteSize);
-
-	return res;
-}
-
-Result SlimKTX2::getImage(uint8_t*& _outImageData, uint32_t _level, uint32_t _face, uint32_t _layer, uint64_t _imageSize) const
-{
-	if (m_pMipLevelArray == nullptr)
+	m_pMipLevelArray[_level] = allocateLevelStorage(static_cast<size_t>(levelSize));
+	if (m_pMipLevelArray[_level] == nullptr)
 	{
 		return Result::MipLevelArryNotAllocated;
 	}
-	if (_level >= m_header.levelCount)
-	{
-		return Result::InvalidLevelIndex;
-	}
-	if (_face >= m_header.faceCount)
-	{
-		return Result::InvalidFaceIndex;
-	}
-	if (_layer >= getLayerCount())
-	{
-		return Result::InvalidLayerIndex;
-	}
-
-	const uint64_t offset = getFaceImageOffset(_level, _face, _layer);
-
-	if (_imageSize != 0u) 
-	{
-		// for debugging
-		uint64_t levelSize = getFaceSize(m_header.vkFormat, _level, m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
-		levelSize *= getFaceCount();
-		levelSize *= getLayerCount();
-
-		// levelOffset / image out of container bounds
-		if (offset + _imageSize > levelSize)
-		{
-			return Result::InvalidImageSize;
-		}
-	}
-
-	_outImageData = m_pMipLevelArray[_level] + offset;
 
 	return Result::Success;
 }
 
-uint32_t SlimKTX2::getImageCount() const
+uint64_t SlimKTX2::getLevelSize(uint32_t _level) const
 {
-	// http://github.khronos.org/KTX-Specification/#_supercompression_global_data
-
-	uint32_t layerPixelDepth = max(m_header.pixelDepth, 1u);
-	for (uint32_t i = 1; i < m_header.levelCount; ++i)
-	{
-		layerPixelDepth += max(m_header.pixelDepth >> i, 1u);
-	}
-
-	return max(m_header.layerCount, 1u) * m_header.faceCount * layerPixelDepth;
+	uint64_t levelSize = getFaceSize(m_header.vkFormat, _level, m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
+	levelSize *= getFaceCount();
+	levelSize *= getLayerCount();
+	return levelSize;
 }
 
-void* SlimKTX2::allocate(size_t _size)
+bool SlimKTX2::isUASTC() const
 {
-	return m_callbacks.allocate(m_callbacks.userData, _size);
+	DataFormatDesc::Block block;
+	return m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::BasisLZ) &&
+		m_dfd.getFirstBlock(block) && block.header.colorModel == ColorModel_UASTC;
 }
 
-void SlimKTX2::free(void* _pData)
+uint64_t SlimKTX2::getUASTCLevelSize(uint32_t _level) const
 {
-	m_callbacks.deallocate(m_callbacks.userData, _pData);
+	// 16 byte 4x4 blocks, the same layout as BC7
+	uint64_t levelSize = getFaceSize(Format::BC7_UNORM_BLOCK, _level, m_header.pixelWidth, m_header.pixelHeight, m_header.pixelDepth);
+	levelSize *= getFaceCount();
+	levelSize *= getLayerCount();
+	return levelSize;
 }
 
-void SlimKTX2::writePadding(IOHandle _file, size_t _byteSize) const
+uint8_t* SlimKTX2::allocateLevelStorage(size_t _size)
 {
-	const uint8_t pad = 0u;
-	for (uint32_t i = 0; i < _byteSize; ++i)
+	if (m_spareLevelStorageCount != 0u)
 	{
-		write(_file, &pad);
+		uint8_t* pData = takeSpareLevelStorage(_size);
+		if (pData != nullptr)
+		{
+			return pData;
+		}
 	}
-}
 
-size_t SlimKTX2::tell(const IOHandle _file)
-{
-	return m_callbacks.tell(m_callbacks.userData, _file);
-}
+	if (m_callbacks.allocateAligned != nullptr && m_callbacks.deallocateAligned != nullptr)
+	{
+		return static_cast<uint8_t*>(m_callbacks.allocateAligned(m_callbacks.userData, _size, m_mipAlignment));
+	}
 
-bool SlimKTX2::seek(IOHandle _file, size_t _offset)
-{
-	return m_callbacks.seek(m_callbacks.userData, _file, _offset);
+	// over allocate and keep the pointer to the block in front of the aligned data
+	uint8_t* pBlock = static_cast<uint8_t*>(allocate(_size + m_mipAlignment + sizeof(void*)));
+	if (pBlock == nullptr)
+	{
+		return nullptr;
+	}
+
+	const uintptr_t address = reinterpret_cast<uintptr_t>(pBlock) + sizeof(void*);
+	uint8_t* pData = pBlock + sizeof(void*) + ((m_mipAlignment - address % m_mipAlignment) % m_mipAlignment);
+
+	memcpy(pData - sizeof(void*), &pBlock, sizeof(void*));
+
+	return pData;
 }
 
-void SlimKTX2::log(const char* _pFormat, ...)
+void SlimKTX2::freeLevelStorage(uint8_t* _pData)
 {
-	if (m_callbacks.log != nullptr)
+	if (m_callbacks.allocateAligned != nullptr && m_callbacks.deallocateAligned != nullptr)
 	{
-		va_list args;
-		va_start(args, _pFormat);
-		m_callbacks.log(m_callbacks.userData, _pFormat, args);
-		va_end(args);
+		m_callbacks.deallocateAligned(m_callbacks.userData, _pData);
+		return;
 	}
-}
 
-uint32_t SlimKTX2::getKtxLevel(uint32_t _level) const
-{
-	return getLevelCount() - _level - 1u;
+	uint8_t* pBlock = nullptr;
+	memcpy(&pBlock, _pData - sizeof(void*), sizeof(void*));
+
+	free(pBlock);
 }
 
-void SlimKTX2::destroyDFD()
+Result SlimKTX2::allocateLevelReadBuffer(uint32_t _level, uint8_t*& _pOutReadBuffer)
 {
-	auto* pBlock = m_dfd.pBlocks;
-	while (pBlock != nullptr)
-	{
-		auto* pNext = pBlock->pNext;
-		pBlock->pNext = nullptr;
+	const LevelIndex& lvl = m_pLevels[_level];
+	const bool isZstd = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::Zstandard);
+	const bool isUncompressed = m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::None);
+	const bool transcodeUASTC = m_pTranscoder != nullptr && m_header.supercompressionScheme != static_cast<uint32_t>(SupercompressionScheme::BasisLZ);
 
-		if (pBlock->pSamples != nullptr)
+	if (isUncompressed && transcodeUASTC == false)
+	{
+		if (lvl.byteLength > getLevelSize(_level))
 		{
-			free(pBlock->pSamples);
-			pBlock->pSamples = nullptr;
+			return Result::InvalidImageSize;
 		}
 
-		free(pBlock);
-		pBlock = pNext;
-	};
-	m_dfd.pBlocks = nullptr;
-}
+		// read directly to the level
+		_pOutReadBuffer = m_pMipLevelArray[_level];
+		return Result::Success;
+	}
 
-bool SlimKTX2::readDFD(IOHandle _file)
-{
-	if (read(_file, &m_dfd.totalSize) == false)
+	// BasisLZ levels have no uncompressedByteLength, UASTC levels hold the blocks before transcoding
+	const uint64_t decodedSize = transcodeUASTC ? getUASTCLevelSize(_level) : getLevelSize(_level);
+	if ((isZstd && lvl.uncompressedByteLength != decodedSize) || (isUncompressed && lvl.byteLength != decodedSize))
 	{
-		return false;
+		return Result::InvalidImageSize;
 	}
 
-	destroyDFD();
+	if (m_pSourceData != nullptr)
+	{
+		if (lvl.byteOffset > m_sourceByteSize || lvl.byteLength > m_sourceByteSize - lvl.byteOffset)
+		{
+			return Result::IOReadFail;
+		}
 
-	uint32_t remainingSize = m_dfd.totalSize;
+		// decompressed in place, the data is not modified
+		_pOutReadBuffer = const_cast<uint8_t*>(m_pSourceData + lvl.byteOffset);
+		return Result::Success;
+	}
 
-	auto* pBlock = m_dfd.pBlocks;
-	// we still have data to read
-	while (remainingSize >= DataFormatDesc::blockHeaderSize)
+	_pOutReadBuffer = allocateArray<uint8_t>(lvl.byteLength);
+	if (_pOutReadBuffer == nullptr)
 	{
-		auto* pNew = allocateArray<DataFormatDesc::Block>();
+		return Result::MipLevelArryNotAllocated;
+	}
 
-		if (pBlock != nullptr)
-		{
-			pBlock->pNext = pNew;
-		}
-		else
+	return Result::Success;
+}
+
+Result SlimKTX2::readLevels(uint8_t** _pReadLevels, uint32_t _firstLevel, uint32_t _lastLevel)
+{
+	if (m_callbacks.readAt == nullptr && m_callbacks.readBatch == nullptr && m_pStorage == nullptr)
+	{
+		// ktx stores the smallest level first, read in file order
+		for (uint32_t level = _lastLevel + 1u; level-- > _firstLevel;)
 		{
-			m_dfd.pBlocks = pNew;
+			if (_pReadLevels[level] != nullptr && readAt(m_file, m_pLevels[level].byteOffset, _pReadLevels[level], m_pLevels[level].byteLength) == false)
+			{
+				return Result::IOReadFail;
+			}
 		}
 
-		if (read(_file, &pNew->header) == false)
+		return Result::Success;
+	}
+
+	ReadRequest* pRequests = allocateArray<ReadRequest>(_lastLevel - _firstLevel + 1u);
+	if (pRequests == nullptr)
+	{
+		return Result::IOReadFail;
+	}
+
+	// uncompressed levels are read to the contiguous storage, levels laid out like in the file are read together with the padding in between
+	const bool mergeLevels = m_pStorage != nullptr && m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::None) && m_pTranscoder == nullptr;
+
+	// one request per level in file order
+	uint32_t requestCount = 0u;
+	for (uint32_t level = _lastLevel + 1u; level-- > _firstLevel;)
+	{
+		if (_pReadLevels[level] == nullptr)
 		{
-			destroyDFD();
-			return false;
+			continue;
 		}
 
-		const uint32_t numSamples = pNew->getSampleCount();
-		const size_t sampleSize = numSamples * sizeof(DataFormatDesc::Sample);
+		const size_t offset = static_cast<size_t>(m_pLevels[level].byteOffset);
+		const size_t size = static_cast<size_t>(m_pLevels[level].byteLength);
 
-		remainingSize -= sizeof(DataFormatDesc::BlockHeader);
-
-		if (numSamples > 0 && remainingSize >= sampleSize)
+		if (mergeLevels && requestCount != 0u)
 		{
-			pNew->pSamples = allocateArray<DataFormatDesc::Sample>(numSamples);
+			ReadRequest& prev = pRequests[requestCount - 1u];
+			const size_t prevEnd = prev.offset + prev.size;
+			const uint8_t* pPrevEnd = static_cast<uint8_t*>(prev.pData) + prev.size;
 
-			if (read(_file, pNew->pSamples, numSamples) == false)
+			if (offset >= prevEnd && _pReadLevels[level] >= pPrevEnd && offset - prevEnd == static_cast<size_t>(_pReadLevels[level] - pPrevEnd))
 			{
-				destroyDFD();
-				return false;
+				prev.size = offset + size - prev.offset;
+				continue;
 			}
-
-			remainingSize -= static_cast<uint32_t>(sampleSize);
 		}
 
-		pBlock = pNew;
+		ReadRequest& request = pRequests[requestCount++];
+		request.offset = offset;
+		request.pData = _pReadLevels[level];
+		request.size = size;
+		request.bytesRead = 0u;
 	}
 
-	return true;
+	bool complete = requestCount == 0u;
+
+	if (complete == false && m_callbacks.readBatch != nullptr)
+	{
+		complete = m_callbacks.readBatch(m_callbacks.userData, m_file, pRequests, requestCount);
+	}
+
+	if (complete == false)
+	{
+		complete = readRequests(pRequests, requestCount);
+	}
+
+	free(pRequests);
+
+	return complete ? Result::Success : Result::IOReadFail;
 }
 
-void SlimKTX2::writeDFD(IOHandle _file) const
+bool SlimKTX2::readRequests(ReadRequest* _pRequests, uint32_t _count)
 {
-	write(_file, &m_dfd.totalSize);
-	auto* pBlock = m_dfd.pBlocks;
-	while (pBlock != nullptr)
+	struct ReadTask
+	{
+		SlimKTX2* pImage;
+		ReadRequest* pRequests;
+		std::atomic<bool> failed;
+	} task{ this, _pRequests, { false } };
+
+	auto readRemaining = [](void* _pTaskData, uint32_t _index)
 	{
-		write(_file, &pBlock->header);
+		ReadTask& task = *static_cast<ReadTask*>(_pTaskData);
+		ReadRequest& request = task.pRequests[_index];
 
-		if (pBlock->pSamples != nullptr)
+		// continue partially completed batch reads
+		if (request.bytesRead < request.size)
 		{
-			const uint32_t numSamples = pBlock->getSampleCount();
-			write(_file, pBlock->pSamples, numSamples);
+			uint8_t* pDst = static_cast<uint8_t*>(request.pData) + request.bytesRead;
+			if (task.pImage->readAt(task.pImage->m_file, request.offset + request.bytesRead, pDst, request.size - request.bytesRead) == false)
+			{
+				task.failed = true;
+			}
 		}
-
-		pBlock = pBlock->pNext;
 	};
-}
 
-void SlimKTX2::destroyKVD()
-{
-	auto* pEntry = m_kvd.pKeyValues;
-	while (pEntry != nullptr)
+	if (m_callbacks.readAt != nullptr)
 	{
-		auto* pNext = pEntry->pNext;
-		pEntry->pNext = nullptr;
-
-		if (pEntry->pKeyValue != nullptr)
+		// positional reads are stateless and can be issued concurrently
+		parallelFor(_count, readRemaining, &task);
+	}
+	else
+	{
+		for (uint32_t i = 0u; i < _count; ++i)
 		{
-			free(pEntry->pKeyValue);
-			pEntry->pKeyValue = nullptr;
+			readRemaining(&task, i);
 		}
+	}
 
-		free(pEntry);
-		pEntry = pNext;
-	};
-	m_kvd.pKeyValues = nullptr;
+	return task.failed == false;
 }
 
-bool SlimKTX2::readKVD(IOHandle _file)
+Result SlimKTX2::streamLevels(const bool* _pLoadLevels, uint32_t _firstLevel, uint32_t _lastLevel)
 {
-	destroyKVD();
+#ifdef SLIMKTX2_USE_BASISU
+	if (m_pTranscoder == nullptr || m_pTranscoder->streamLevels(*this, _pLoadLevels, _firstLevel, _lastLevel) == false)
+	{
+		return Result::BasisTranscodeFailed;
+	}
 
-	uint32_t remainingSize = m_sections.kvdByteLength;
+	return Result::Success;
+#else
+	log("slimktx2 not compiled with basisu support\n");
+	return Result::UnknownFormat;
+#endif
+}
 
-	auto* pEntry = m_kvd.pKeyValues;
-	while (remainingSize >= sizeof(uint32_t) + 2u) // minimum entry size 
+Result SlimKTX2::decompressLevels(uint8_t** _pCompressedLevels, uint32_t _firstLevel, uint32_t _lastLevel)
+{
+	if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::BasisLZ) ||
+		m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::None))
 	{
-		auto* pNew = allocateArray<KeyValueData::Entry>();
+		return transcodeLevels(_pCompressedLevels, _firstLevel, _lastLevel);
+	}
+	else if (m_header.supercompressionScheme == static_cast<uint32_t>(SupercompressionScheme::Zstandard))
+	{
+#ifdef SLIMKTX2_USE_ZSTD
+		// UASTC levels are decompressed to temporary buffers and transcoded from there
+		uint8_t** pUASTCLevels = nullptr;
+		Result res = Result::Success;
 
-		if (pEntry != nullptr)
-		{
-			pEntry->pNext = pNew;
-		}
-		else
+		if (m_pTranscoder != nullptr)
 		{
-			m_kvd.pKeyValues = pNew;
-		}
+			pUASTCLevels = allocateArray<uint8_t*>(getLevelCount());
+			if (pUASTCLevels == nullptr)
+			{
+				return Result::MipLevelArryNotAllocated;
+			}
+			memset(pUASTCLevels, 0, sizeof(uint8_t*) * getLevelCount());
 
-		if (read(_file, &pNew->keyAndValueByteLength) == false)
-		{
-			return false;
+			for (uint32_t level = _firstLevel; level <= _lastLevel && res == Result::Success; ++level)
+			{
+				if (_pCompressedLevels[level] != nullptr)
+				{
+					pUASTCLevels[level] = allocateArray<uint8_t>(static_cast<size_t>(m_pLevels[level].uncompressedByteLength));
+					if (pUASTCLevels[level] == nullptr)
+					{
+						res = Result::MipLevelArryNotAllocated;
+					}
+				}
+			}
 		}
 
-		remainingSize -= sizeof(uint32_t);
-		remainingSize -= pNew->keyAndValueByteLength;
-
-		pNew->pKeyValue = allocateArray<uint8_t>(pNew->keyAndValueByteLength);
-		if (read(_file, pNew->pKeyValue, pNew->keyAndValueByteLength) == false)
+		struct DecompressTask
 		{
-			return false;
+			SlimKTX2* pImage;
+			uint8_t** pCompressedLevels;
+			uint8_t** pDecompressedLevels;
+			uint32_t firstLevel;
+			std::atomic<bool> failed;
+		} task{ this, _pCompressedLevels, pUASTCLevels != nullptr ? pUASTCLevels : m_pMipLevelArray, _firstLevel, { false } };
+
+		if (res == Result::Success)
+		{
+			parallelFor(_lastLevel - _firstLevel + 1u, [](void* _pTaskData, uint32_t _index)
+			{
+				DecompressTask& task = *static_cast<DecompressTask*>(_pTaskData);
+				const uint32_t level = task.firstLevel + _index;
+				const uint8_t* pCompressed = task.pCompressedLevels[level];
+
+				if (pCompressed == nullptr)
+				{
+					return; // was already loaded
+				}
+
+				const LevelIndex& lvl = task.pImage->m_pLevels[level];
+				if (zstdDecompress(task.pDecompressedLevels[level], lvl.uncompressedByteLength, pCompressed, lvl.byteLength) == false)
+				{
+					task.failed = true;
+				}
+			}, &task);
+
+			if (task.failed)
+			{
+				log("zstd decompression failed\n");
+				res = Result::ZstdDecompressFailed;
+			}
 		}
 
-		const uint32_t padding = getPadding(pNew->keyAndValueByteLength, 4u);
-		if (padding != 0u)
+		if (pUASTCLevels != nullptr)
 		{
-			auto pos = tell(_file);
-			seek(_file, pos + padding);
-			remainingSize -= padding;		
+			if (res == Result::Success)
+			{
+				res = transcodeLevels(pUASTCLevels, _firstLevel, _lastLevel);
+			}
+
+			for (uint32_t level = _firstLevel; level <= _lastLevel; ++level)
+			{
+				if (pUASTCLevels[level] != nullptr)
+				{
+					free(pUASTCLevels[level]);
+				}
+			}
+			free(pUASTCLevels);
 		}
+
+		return res;
+#else
+		log("slimktx2 not compiled with zstd support\n");
+		return Result::UnknownFormat;
+#endif
 	}
 
-	return remainingSize == 0u;
+	log("unknown supercompression scheme %u\n", m_header.supercompressionScheme);
+	return Result::NotImplemented;
 }
 
-void SlimKTX2::writeKVD(IOHandle _file) const
+Result SlimKTX2::transcodeLevels(uint8_t* const* _pEncodedLevels, uint32_t _firstLevel, uint32_t _lastLevel)
 {
-	auto* pEntry = m_kvd.pKeyValues;
-	while (pEntry != nullptr)
+#ifdef SLIMKTX2_USE_BASISU
+	if (m_pTranscoder == nullptr || m_pTranscoder->decompressLevels(*this, _pEncodedLevels, _firstLevel, _lastLevel) == false)
 	{
-		write(_file, &pEntry->keyAndValueByteLength);
-		if (pEntry->pKeyValue != nullptr && pEntry->keyAndValueByteLength > 0u)
-		{
-			write(_file, pEntry->pKeyValue, pEntry->keyAndValueByteLength);
-			const uint32_t padding = getPadding(pEntry->keyAndValueByteLength, 4u);
-			writePadding(_file, padding);
-		}
-		pEntry = pEntry->pNext;
-	};
+		return Result::BasisTranscodeFailed;
+	}
+
+	return Result::Success;
+#else
+	log("slimktx2 not compiled with basisu support\n");
+	return Result::UnknownFormat;
+#endif
 }
 
-void SlimKTX2::destroySGD()
+Result SlimKTX2::compressLevels(uint8_t**& _pCompressedLevels)
 {
-	if (m_basisLZ.pImageDescs != nullptr)
-	{
-		free(m_basisLZ.pImageDescs);
-		m_basisLZ.pImageDescs = nullptr;
-	}
+#ifdef SLIMKTX2_USE_ZSTD
+	const uint32_t levelCount = getLevelCount();
 
-	if (m_basisLZ.pEndpoints != nullptr)
+	_pCompressedLevels = allocateArray<uint8_t*>(levelCount);
+	if (_pCompressedLevels == nullptr)
 	{
-		free(m_basisLZ.pEndpoints);
-		m_basisLZ.pEndpoints = nullptr;
+		return Result::MipLevelArryNotAllocated;
 	}
+	memset(_pCompressedLevels, 0, sizeof(uint8_t*) * levelCount);
 
-	if (m_basisLZ.pSelectors != nullptr)
+	// allocate up front, the allocation callbacks are not required to be thread safe
+	for (uint32_t level = 0u; level < levelCount; ++level)
 	{
-		free(m_basisLZ.pSelectors);
-		m_basisLZ.pSelectors = nullptr;
+		if (m_pMipLevelArray[level] == nullptr)
+		{
+			return Result::MipLevelArryNotAllocated;
+		}
+
+		m_pLevels[level].byteLength = zstdCompressBound(getLevelSize(level));
+
+		_pCompressedLevels[level] = allocateArray<uint8_t>(m_pLevels[level].byteLength);
+		if (_pCompressedLevels[level] == nullptr)
+		{
+			return Result::MipLevelArryNotAllocated;
+		}
 	}
 
-	if (m_basisLZ.pTables != nullptr)
+	struct CompressTask
 	{
-		free(m_basisLZ.pTables);
-		m_basisLZ.pTables = nullptr;
-	}
+		SlimKTX2* pImage;
+		uint8_t** pCompressedLevels;
+		std::atomic<bool> failed;
+	} task{ this, _pCompressedLevels, { false } };
 
-	if (m_basisLZ.pExtendedData != nullptr)
+	parallelFor(levelCount, [](void* _pTaskData, uint32_t _level)
 	{
-		free(m_basisLZ.pExtendedData);
-		m_basisLZ.pExtendedData = nullptr;
-	}
-}
+		CompressTask& task = *static_cast<CompressTask*>(_pTaskData);
+		SlimKTX2& image = *task.pImage;
+		LevelIndex& lvl = image.m_pLevels[_level];
 
-Result SlimKTX2::readSGD(IOHandle _file)
-{
-	// only basis lz for now
+		lvl.byteLength = zstdCompress(task.pCompressedLevels[_level], lvl.byteLength, image.m_pMipLevelArray[_level], image.getLevelSize(_level), image.m_zstdCompressionLevel);
+		if (lvl.byteLength == 0u)
+		{
+			task.failed = true;
+		}
+	}, &task);
 
-	if (read(_file, &m_basisLZ.header) == false)
+	if (task.failed)
 	{
-		return Result::IOReadFail;
+		log("zstd compression failed\n");
+		return Result::ZstdCompressFailed;
 	}
 
-	const uint32_t imageCount = getImageCount();
+	return Result::Success;
+#else
+	return Result::UnknownFormat;
+#endif
+}
 
-	m_basisLZ.pImageDescs = allocateArray<BasisLZ::ImageDesc>(imageCount);
-	if (m_basisLZ.pImageDescs == nullptr)
-	{
-		return Result::SupercompressionGlobalDataNotAllocated;
-	}
-	if (read(_file, m_basisLZ.pImageDescs, imageCount) == false)
-	{
-		return Result::IOReadFail;
-	}
+void SlimKTX2::setZstdCompressionLevel(int32_t _level)
+{
+	m_zstdCompressionLevel = _level;
+}
 
-	m_basisLZ.pEndpoints = allocateArray<uint8_t>(m_basisLZ.header.endpointsByteLength);
-	if (m_basisLZ.pEndpoints == nullptr)
-	{
-		return Result::SupercompressionGlobalDataNotAllocated;
-	}
-	if (read(_file, m_basisLZ.pEndpoints, m_basisLZ.header.endpointsByteLength) == false)
+void SlimKTX2::destroyLevelData(uint8_t** _pLevelData)
+{
+	if (_pLevelData == nullptr)
 	{
-		return Result::IOReadFail;
+		return;
 	}
 
-	m_basisLZ.pSelectors = allocateArray<uint8_t>(m_basisLZ.header.selectorsByteLength);
-	if (m_basisLZ.pSelectors == nullptr)
-	{
-		return Result::SupercompressionGlobalDataNotAllocated;
-	}
-	if (read(_file, m_basisLZ.pSelectors, m_basisLZ.header.selectorsByteLength) == false)
+	const uint32_t levelCount = getLevelCount();
+	for (uint32_t level = 0u; level < levelCount; ++level)
 	{
-		return Result::IOReadFail;
+		if (_pLevelData[level] != nullptr)
+		{
+			free(_pLevelData[level]);
+		}
 	}
+	free(_pLevelData);
+}
 
-	m_basisLZ.pTables = allocateArray<uint8_t>(m_basisLZ.header.tablesByteLength);
-	if (m_basisLZ.pTables == nullptr)
-	{
-		return Result::SupercompressionGlobalDataNotAllocated;
-	}
-	if (read(_file, m_basisLZ.pTables, m_basisLZ.header.tablesByteLength) == false)
+void SlimKTX2::unloadLevel(uint32_t _level)
+{
+	if (m_pMipLevelArray[_level] != nullptr)
 	{
-		return Result::IOReadFail;
+		// stored levels stay allocated with the storage
+		if (m_pStorage == nullptr)
+		{
+			freeLevelStorage(m_pMipLevelArray[_level]);
+		}
+		m_pMipLevelArray[_level] = nullptr;
 	}
+}
 
-	m_basisLZ.pExtendedData = allocateArray<uint8_t>(m_basisLZ.header.extendedByteLength);
-	if (m_basisLZ.pExtendedData == nullptr)
+void SlimKTX2::parallelFor(uint32_t _count, TaskFunc _task, void* _pTaskData)
+{
+	if (m_callbacks.parallelFor != nullptr)
 	{
-		return Result::SupercompressionGlobalDataNotAllocated;
+		m_callbacks.parallelFor(m_callbacks.userData, _count, _task, _pTaskData);
 	}
-	if (read(_file, m_basisLZ.pExtendedData, m_basisLZ.header.extendedByteLength) == false)
+	else
 	{
-		return Result::IOReadFail;
+		for (uint32_t i = 0u; i < _count; ++i)
+		{
+			_task(_pTaskData, i);
+		}
 	}
-
-	return Result::Success;
-}
-
-void SlimKTX2::writeSGD(IOHandle _file) const
-{
-	// only basis lz for now
-
-	write(_file, &m_basisLZ.header);
-
-	const uint32_t imageCount = getImageCount();
-
-	write(_file, m_basisLZ.pImageDescs, imageCount);
-	write(_file, m_basisLZ.pEndpoints, m_basisLZ.header.endpointsByteLength);
-	write(_file, m_basisLZ.pSelectors, m_basisLZ.header.selectorsByteLength);
-	write(_file, m_basisLZ.pTables, m_basisLZ.header.tablesByteLength);
-	write(_file, m_basisLZ.pExtendedData, m_basisLZ.header.extendedByteLength);
 }
 
-void SlimKTX2::destoryMipLevelArray()
+void SlimKTX2::destroyTranscoder()
 {
-	if (m_pMipLevelArray != nullptr)
+#ifdef SLIMKTX2_USE_BASISU
+	if (m_pTranscoder != nullptr)
 	{
-		for (uint32_t i = 0u; i < getLevelCount(); ++i)
-		{
-			free(m_pMipLevelArray[i]);
-		}
-
-		free(m_pMipLevelArray);
-		m_pMipLevelArray = nullptr;
+		m_pTranscoder->~BasisTranscoder();
+		free(m_pTranscoder);
 	}
+#endif
+	m_pTranscoder = nullptr;
 }
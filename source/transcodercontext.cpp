@@ -0,0 +1,216 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#include "transcodercontext.h"
+
+#ifdef SLIMKTX2_USE_BASISU
+#include "basistranscoder.h"
+
+#include <cstring>
+#include <new>
+#endif
+
+using namespace ux3d::slimktx2;
+
+TranscoderContext::TranscoderContext(const Callbacks& _callbacks, uint32_t _maxCachedCodebooks) :
+	m_maxCachedCodebooks(_maxCachedCodebooks)
+{
+	m_callbacks.userData = _callbacks.userData;
+	m_callbacks.allocate = _callbacks.allocate;
+	m_callbacks.deallocate = _callbacks.deallocate;
+
+#ifdef SLIMKTX2_USE_BASISU
+	BasisTranscoder::initBasisu();
+#endif
+}
+
+TranscoderContext::~TranscoderContext()
+{
+	// all SlimKTX2 objects using this context have to be destroyed or cleared at this point
+	std::lock_guard<std::mutex> lock(m_mutex);
+	evict(0u);
+}
+
+void TranscoderContext::trim()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	evict(0u);
+}
+
+uint32_t TranscoderContext::getCodebookCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_codebookCount;
+}
+
+TranscoderContext::Codebook* TranscoderContext::acquire(const BasisLZ& _basisLZ)
+{
+#ifdef SLIMKTX2_USE_BASISU
+	const BasisLZ::Header& header = _basisLZ.header;
+	const uint64_t hash = BasisTranscoder::hashCodebook(_basisLZ);
+	const size_t dataSize = static_cast<size_t>(header.endpointsByteLength) + header.selectorsByteLength + header.tablesByteLength;
+
+	// the hash only preselects, codebooks are compared byte by byte
+	auto matches = [&](const Codebook& _codebook)
+	{
+		if (_codebook.hash != hash || memcmp(&_codebook.header, &header, sizeof(BasisLZ::Header)) != 0)
+		{
+			return false;
+		}
+
+		const uint8_t* pData = _codebook.pData;
+		return (header.endpointsByteLength == 0u || memcmp(pData, _basisLZ.pEndpoints, header.endpointsByteLength) == 0) &&
+			(header.selectorsByteLength == 0u || memcmp(pData + header.endpointsByteLength, _basisLZ.pSelectors, header.selectorsByteLength) == 0) &&
+			(header.tablesByteLength == 0u || memcmp(pData + header.endpointsByteLength + header.selectorsByteLength, _basisLZ.pTables, header.tablesByteLength) == 0);
+	};
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Codebook* pPrev = nullptr;
+	for (Codebook* pCodebook = m_pCodebooks; pCodebook != nullptr; pPrev = pCodebook, pCodebook = pCodebook->pNext)
+	{
+		if (matches(*pCodebook))
+		{
+			// move to front
+			if (pPrev != nullptr)
+			{
+				pPrev->pNext = pCodebook->pNext;
+				pCodebook->pNext = m_pCodebooks;
+				m_pCodebooks = pCodebook;
+			}
+
+			++pCodebook->refCount;
+
+			// concurrent parses of files sharing a codebook wait for the first one instead of decoding it again
+			m_decoded.wait(lock, [pCodebook]() { return pCodebook->state != Codebook::State::Decoding; });
+
+			if (pCodebook->state == Codebook::State::Failed)
+			{
+				if (--pCodebook->refCount == 0u)
+				{
+					destroy(pCodebook);
+				}
+				return nullptr;
+			}
+
+			return pCodebook;
+		}
+	}
+
+	void* pMemory = m_callbacks.allocate(m_callbacks.userData, sizeof(Codebook));
+	uint8_t* pData = static_cast<uint8_t*>(m_callbacks.allocate(m_callbacks.userData, dataSize != 0u ? dataSize : 1u));
+	if (pMemory == nullptr || pData == nullptr)
+	{
+		if (pMemory != nullptr)
+		{
+			m_callbacks.deallocate(m_callbacks.userData, pMemory);
+		}
+		if (pData != nullptr)
+		{
+			m_callbacks.deallocate(m_callbacks.userData, pData);
+		}
+		return nullptr;
+	}
+
+	if (header.endpointsByteLength != 0u)
+	{
+		memcpy(pData, _basisLZ.pEndpoints, header.endpointsByteLength);
+	}
+	if (header.selectorsByteLength != 0u)
+	{
+		memcpy(pData + header.endpointsByteLength, _basisLZ.pSelectors, header.selectorsByteLength);
+	}
+	if (header.tablesByteLength != 0u)
+	{
+		memcpy(pData + header.endpointsByteLength + header.selectorsByteLength, _basisLZ.pTables, header.tablesByteLength);
+	}
+
+	Codebook* pCodebook = new(pMemory) Codebook();
+	pCodebook->hash = hash;
+	pCodebook->header = header;
+	pCodebook->pData = pData;
+	pCodebook->refCount = 1u;
+	pCodebook->pNext = m_pCodebooks;
+
+	m_pCodebooks = pCodebook;
+	++m_codebookCount;
+
+	evict(m_maxCachedCodebooks);
+
+	// decode without the lock, files with other codebooks are not blocked. the entry is in use and can not be evicted meanwhile
+	lock.unlock();
+	const bool decoded = BasisTranscoder::decodeCodebook(pCodebook->etc1s, _basisLZ);
+	lock.lock();
+
+	pCodebook->state = decoded ? Codebook::State::Decoded : Codebook::State::Failed;
+	m_decoded.notify_all();
+
+	if (decoded == false)
+	{
+		if (--pCodebook->refCount == 0u)
+		{
+			destroy(pCodebook);
+		}
+		return nullptr;
+	}
+
+	return pCodebook;
+#else
+	return nullptr;
+#endif
+}
+
+void TranscoderContext::release(Codebook* _pCodebook)
+{
+#ifdef SLIMKTX2_USE_BASISU
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	--_pCodebook->refCount;
+
+	evict(m_maxCachedCodebooks);
+#endif
+}
+
+void TranscoderContext::evict(uint32_t _maxCount)
+{
+#ifdef SLIMKTX2_USE_BASISU
+	while (m_codebookCount > _maxCount)
+	{
+		// least recently used codebook that is not in use
+		Codebook* pUnused = nullptr;
+		for (Codebook* pCodebook = m_pCodebooks; pCodebook != nullptr; pCodebook = pCodebook->pNext)
+		{
+			if (pCodebook->refCount == 0u)
+			{
+				pUnused = pCodebook;
+			}
+		}
+
+		if (pUnused == nullptr)
+		{
+			return;
+		}
+
+		destroy(pUnused);
+	}
+#endif
+}
+
+void TranscoderContext::destroy(Codebook* _pCodebook)
+{
+#ifdef SLIMKTX2_USE_BASISU
+	Codebook** ppCodebook = &m_pCodebooks;
+	while (*ppCodebook != _pCodebook)
+	{
+		ppCodebook = &(*ppCodebook)->pNext;
+	}
+	*ppCodebook = _pCodebook->pNext;
+
+	m_callbacks.deallocate(m_callbacks.userData, _pCodebook->pData);
+
+	_pCodebook->~Codebook();
+	m_callbacks.deallocate(m_callbacks.userData, _pCodebook);
+	--m_codebookCount;
+#else
+	(void)_pCodebook;
+#endif
+}
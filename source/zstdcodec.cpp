@@ -0,0 +1,21 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#include "zstdcodec.h"
+#include <zstd.h>
+
+bool ux3d::slimktx2::zstdDecompress(void* _pDst, size_t _dstSize, const void* _pSrc, size_t _srcSize)
+{
+	const size_t result = ZSTD_decompress(_pDst, _dstSize, _pSrc, _srcSize);
+	return ZSTD_isError(result) == 0u && result == _dstSize;
+}
+
+size_t ux3d::slimktx2::zstdCompressBound(size_t _srcSize)
+{
+	return ZSTD_compressBound(_srcSize);
+}
+
+size_t ux3d::slimktx2::zstdCompress(void* _pDst, size_t _dstCapacity, const void* _pSrc, size_t _srcSize, int _level)
+{
+	const size_t result = ZSTD_compress(_pDst, _dstCapacity, _pSrc, _srcSize, _level);
+	return ZSTD_isError(result) == 0u ? result : 0u;
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2020 UX3D GmbH. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+
+namespace ux3d
+{
+	namespace slimktx2
+	{
+		// thin wrappers around libzstd, keeps zstd.h out of the other translation units
+
+		// returns false if the frame could not be decoded or does not decompress to exactly _dstSize bytes
+		bool zstdDecompress(void* _pDst, size_t _dstSize, const void* _pSrc, size_t _srcSize);
+
+		// worst case compressed size of _srcSize bytes
+		size_t zstdCompressBound(size_t _srcSize);
+
+		// returns the compressed size or 0 on failure
+		size_t zstdCompress(void* _pDst, size_t _dstCapacity, const void* _pSrc, size_t _srcSize, int _level);
+	}
+}